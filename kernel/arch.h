@@ -1,4 +1,5 @@
 #pragma once
+#include <libs/common/list.h>
 #include <libs/common/types.h>
 
 struct cpuvar;
@@ -8,14 +9,19 @@ struct cpuvar;
 #define CPUVAR       (arch_cpuvar_get())
 
 struct task;
+struct fast_message;
 
 struct cpuvar {
     struct arch_cpuvar arch;
     int id;
     bool online;
     unsigned ipi_pending;
+    bool idle;//正在执行空闲任务（可以立即执行新的任务）
+    uint64_t account_clock;//最后一次计算正在运行的任务的执行时间时的时钟值
     struct task *idle_task;
     struct task *current_task;
+    list_t runqueues[TASK_PRIORITY_MAX];//该CPU的每个优先级的运行队列
+    unsigned runqueue_bitmap;//可能有任务的运行队列的位图（第i位对应优先级i）
     unsigned magic;
 };
 
@@ -50,16 +56,26 @@ void arch_vm_destroy(struct arch_vm *vm);
 error_t arch_vm_map(struct arch_vm *vm, vaddr_t vaddr, paddr_t paddr,
                     unsigned attrs);
 error_t arch_vm_unmap(struct arch_vm *vm, vaddr_t vaddr);
+paddr_t arch_vm_lookup(struct arch_vm *vm, vaddr_t vaddr, unsigned *attrs);
 vaddr_t arch_paddr_to_vaddr(paddr_t paddr);
 bool arch_is_mappable_uaddr(uaddr_t uaddr);
-error_t arch_task_init(struct task *task, uaddr_t ip, vaddr_t kernel_entry,
-                       void *arg);
+error_t arch_task_init(struct task *task, uaddr_t ip, uaddr_t sp,
+                       vaddr_t kernel_entry, void *arg);
 void arch_task_destroy(struct task *task);
 void arch_task_switch(struct task *prev, struct task *next);
+__noreturn void arch_return_to_user(void);
+__noreturn void arch_syscall_return(long ret, const struct fast_message *fm);
+__noreturn void arch_syscall_restart(void);
 void arch_init(void);
 void arch_init_percpu(void);
 void arch_idle(void);
 void arch_send_ipi(unsigned ipi);
+void arch_send_ipi_to(int cpu, unsigned ipi);
+struct cpuvar *arch_cpuvar_of(int id);
+unsigned arch_uptime(void);
+uint64_t arch_clock(void);
+unsigned arch_clock_elapsed_us(uint64_t *since);
+void arch_timer_set(unsigned deadline);
 void arch_memcpy_from_user(void *dst, __user const void *src, size_t len);
 void arch_memcpy_to_user(__user void *dst, const void *src, size_t len);
 error_t arch_irq_enable(unsigned irq);
@@ -1,4 +1,4 @@
-objs-y += main.o printk.o memory.o task.o interrupt.o ipc.o syscall.o bootelf.o \
+objs-y += main.o printk.o memory.o task.o interrupt.o timer.o ipc.o syscall.o bootelf.o \
           hinavm.o
 subdirs-y += riscv32
 
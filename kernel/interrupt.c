@@ -2,13 +2,11 @@
 #include "arch.h"
 #include "ipc.h"
 #include "task.h"
+#include "timer.h"
 #include <libs/common/print.h>
 
 //接受中断通知的任务列表。
 static struct task *irq_listeners[IRQ_MAX];
-//自启动以来经过的时间。单位取决于定时器中断周期（TICK_HZ）。
-unsigned uptime_ticks = 0;
-
 //允许接受中断通知。
 error_t irq_listen(struct task *task, unsigned irq) {
     if (irq >= IRQ_MAX) {
@@ -62,31 +60,25 @@ void handle_interrupt(unsigned irq) {
     }
 
     notify(task, NOTIFY_IRQ);
+
+    //如果接受中断的任务（设备驱动程序）优先级更高，则立即切换到它。
+    task_preempt();
 }
 
 //定时器中断处理程序
-void handle_timer_interrupt(unsigned ticks) {
-    //更新自启动以来经过的时间
-    uptime_ticks += ticks;
-
-    if (CPUVAR->id == 0) {
-        //更新每个任务的计时器
-        LIST_FOR_EACH (task, &active_tasks, struct task, next) {
-            if (task->timeout > 0) {
-                task->timeout -= MIN(task->timeout, ticks);
-                if (!task->timeout) {
-                    //通知任务已超时
-                    notify(task, NOTIFY_TIMER);
-                }
-            }
-        }
-    }
+void handle_timer_interrupt(void) {
+    //处理到期的定时器。可以在任何CPU上处理。
+    timer_advance();
 
-    //更新正在运行的任务的剩余可运行时间，当剩余可运行时间为零时切换任务。
+    //将到现在为止的时间计入正在运行的任务，从剩余可运行时间和预留CPU时间中扣除。当
+    //剩余可运行时间为零时切换任务。用完了预留CPU时间的任务也降低优先级并切换任务，
+    //使其他任务不会因为它而得不到CPU。
     struct task *current = CURRENT_TASK;
-    DEBUG_ASSERT(current->quantum >= 0 || current == IDLE_TASK);
-    current->quantum -= MIN(ticks, current->quantum);
-    if (!current->quantum) {
+    bool exhausted = task_account();
+    if (!current->quantum || exhausted) {
         task_switch();
+    } else {
+        //其他CPU可能唤醒了优先级更高的任务
+        task_preempt();
     }
 }
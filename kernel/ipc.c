@@ -1,4 +1,5 @@
 #include "ipc.h"
+#include "memory.h"
 #include "syscall.h"
 #include "task.h"
 #include <libs/common/list.h>
@@ -7,9 +8,365 @@
 #include <libs/common/string.h>
 #include <libs/common/types.h>
 
-// 消息发送流程
-static error_t send_message(struct task *dst, __user struct message *m,
-                            unsigned flags) {
+// 从用户空间复制消息。只复制消息头、固定长度字段和可变长度字段的实际长度部分，
+// 而不是整个struct message。
+static error_t copy_message_from_user(struct message *dst,
+                                      __user const struct message *src) {
+    // 首先复制消息头以获取消息类型
+    error_t err = memcpy_from_user(dst, src, MESSAGE_HEADER_LEN);
+    if (err != OK) {
+        return err;
+    }
+
+    // 复制固定长度字段（包括可变长度字段的长度）
+    size_t fixed_len = msg_fixed_len(dst->type);
+    err = memcpy_from_user((uint8_t *) dst + MESSAGE_HEADER_LEN,
+                           (__user const uint8_t *) src + MESSAGE_HEADER_LEN,
+                           fixed_len - MESSAGE_HEADER_LEN);
+    if (err != OK) {
+        return err;
+    }
+
+    // 复制可变长度字段中实际使用的部分
+    size_t len = msg_len(dst);
+    return memcpy_from_user((uint8_t *) dst + fixed_len,
+                            (__user const uint8_t *) src + fixed_len,
+                            len - fixed_len);
+}
+
+// 检查附带在消息中的out-of-line缓冲区，并预先让它的所有页面都映射好。尚未映射的
+// 页面通过访问它们来让寻呼任务进行映射。
+static error_t prepare_ool(uaddr_t uaddr, size_t len) {
+    if (!IS_ALIGNED(uaddr, PAGE_SIZE) || uaddr + len < uaddr
+        || !arch_is_mappable_uaddr(uaddr)
+        || !arch_is_mappable_uaddr(uaddr + len - 1)) {
+        return ERR_INVALID_UADDR;
+    }
+
+    struct task *current = CURRENT_TASK;
+    for (offset_t offset = 0; offset < len; offset += PAGE_SIZE) {
+        unsigned attrs;
+        if (!arch_vm_lookup(&current->process->vm, uaddr + offset, &attrs)) {
+            uint8_t tmp;
+            error_t err = memcpy_from_user(
+                &tmp, (__user const void *) (uaddr + offset), sizeof(tmp));
+            if (err != OK) {
+                return err;
+            }
+        }
+    }
+
+    return OK;
+}
+
+// 将out-of-line缓冲区的页面移动到接收方的接收窗口，并将消息中的地址改写为窗口的地址。
+static error_t move_ool(struct task *dst, uaddr_t *uaddr, size_t len) {
+    if (len > dst->ool_window_size) {
+        WARN("%s: out-of-line buffer is too large for %s (%d > %d bytes)",
+             CURRENT_TASK->name, dst->name, len, dst->ool_window_size);
+        return ERR_TOO_LARGE;
+    }
+
+    error_t err = vm_move_pages(CURRENT_TASK, *uaddr, dst, dst->ool_window,
+                                ALIGN_UP(len, PAGE_SIZE));
+    if (err != OK) {
+        return err;
+    }
+
+    *uaddr = dst->ool_window;
+    return OK;
+}
+
+// 返回邮箱中第 i 个消息。
+static struct message *mailbox_at(struct task *task, unsigned i) {
+    return &task->mailbox[(task->mailbox_head + i) % TASK_MAILBOX_LEN];
+}
+
+// 将异步消息放入目标任务的邮箱。邮箱在第一次使用时分配，很多任务从不接收异步消息。
+// 邮箱已满或无法分配时返回 ERR_WOULD_BLOCK（发送方改用发送方一侧的队列）。
+static error_t mailbox_push(struct task *dst, struct message *m, task_t src) {
+    if (!dst->mailbox) {
+        paddr_t paddr =
+            pm_alloc(TASK_MAILBOX_SIZE, NULL, PM_ALLOC_UNINITIALIZED);
+        if (!paddr) {
+            return ERR_WOULD_BLOCK;
+        }
+
+        dst->mailbox = (struct message *) arch_paddr_to_vaddr(paddr);
+        dst->mailbox_paddr = paddr;
+    }
+
+    if (dst->mailbox_len == TASK_MAILBOX_LEN) {
+        return ERR_WOULD_BLOCK;
+    }
+
+    struct message *slot = mailbox_at(dst, dst->mailbox_len);
+    memcpy(slot, m, msg_len(m));
+    slot->src = src;
+    dst->mailbox_len++;
+    return OK;
+}
+
+// 从邮箱中取出最早的消息。邮箱为空时返回 false。
+static bool mailbox_pop(struct task *task, struct message *m) {
+    if (task->mailbox_len == 0) {
+        return false;
+    }
+
+    struct message *msg = mailbox_at(task, 0);
+    memcpy(m, msg, msg_len(msg));
+    task->mailbox_head = (task->mailbox_head + 1) % TASK_MAILBOX_LEN;
+    task->mailbox_len--;
+    return true;
+}
+
+// 取出一个发送了异步通知的任务ID。使用摘要字，与任务数无关，只需查找两次
+// 最低位即可找到。结束的发送方的位由 forget_async_source 清除。如果没有则返回 0。
+static task_t pop_async_source(struct task *task) {
+    while (task->async_summary) {
+        unsigned word = __builtin_ctz(task->async_summary);
+        unsigned bit = __builtin_ctz(task->async_pending[word]);
+        task->async_pending[word] &= ~(1u << bit);
+        if (!task->async_pending[word]) {
+            task->async_summary &= ~(1u << word);
+        }
+
+        struct task *src = task_find_by_index(word * 32 + bit + 1);
+        if (src) {
+            return src->tid;
+        }
+    }
+
+    return 0;
+}
+
+// 生成 NOTIFY_MSG 消息并清除已告知的通知。每次只告知一个异步通知的发送方，如果
+// 还有其他发送方，则保留 NOTIFY_ASYNC 通知。
+static void build_notify_message(struct task *task, struct message *m) {
+    notifications_t notifications = task->notifications;
+    task_t async_src = 0;
+    if (notifications & NOTIFY_ASYNC) {
+        async_src = pop_async_source(task);
+        if (!async_src) {
+            notifications &= ~NOTIFY_ASYNC;
+        }
+    }
+
+    m->type = NOTIFY_MSG;
+    m->src = FROM_KERNEL;
+    m->notify.notifications = notifications;
+    m->notify.async_src = async_src;
+    m->notify.timers = (notifications & NOTIFY_TIMER) ? task->timers_fired : 0;
+    if (notifications & NOTIFY_TIMER) {
+        task->timers_fired = 0;
+    }
+
+    task->notifications = task->async_summary ? NOTIFY_ASYNC : 0;
+}
+
+// 任务是否正在等待来自任何任务的消息（开放接收）
+static bool is_idle_receiver(struct task *task) {
+    return task->state == TASK_BLOCKED && task->wait_for == IPC_ANY;
+}
+
+// 将发往服务的请求分派给空闲的工作任务。如果没有空闲的工作任务，则选择发送队列
+// 最短的任务。
+static struct task *dispatch(struct task *dst) {
+    if (list_is_empty(&dst->workers) || is_idle_receiver(dst)) {
+        return dst;
+    }
+
+    struct task *current = CURRENT_TASK;
+    struct task *best = dst;
+    size_t best_len = list_len(&dst->senders);
+    LIST_FOR_EACH (worker, &dst->workers, struct task, worker_next) {
+        if (worker == current || worker->destroyed) {
+            continue;
+        }
+
+        if (is_idle_receiver(worker)) {
+            return worker;
+        }
+
+        size_t len = list_len(&worker->senders);
+        if (len < best_len) {
+            best = worker;
+            best_len = len;
+        }
+    }
+
+    return best;
+}
+
+// 消息已经交给了接收方，恢复接收方。
+static void wake_receiver(struct task *dst, unsigned flags) {
+    struct task *current = CURRENT_TASK;
+    bool is_reply = dst->wait_for == current->tid;
+    if ((flags & IPC_RECV) && !(flags & IPC_NOBLOCK)) {
+        // 调用 (IPC_CALL) 或回复并接收 (IPC_REPLY_RECV): 发送方接下来通常会阻塞等待
+        // 消息，因此在当前CPU上直接切换到目标任务。调用时将剩余的CPU时间转让给它并
+        // 记录借出方，处理请求的任务在回复时归还CPU时间。回复并接收时与普通的回复
+        // 一样，只归还借来的CPU时间：接收时如果已有消息则不会阻塞，继续运行的本任务
+        // 不能同时保留已经交出的CPU时间。
+        unsigned quantum = 0;
+        if (!(flags & IPC_REPLY) || current->donor == dst->tid) {
+            quantum = current->quantum;
+            current->quantum = 0;
+        }
+
+        task_handoff(dst, quantum);
+        if (!(flags & IPC_REPLY)) {
+            dst->donor = current->tid;
+        }
+    } else if (is_reply) {
+        // 回复: 目标任务正在等待本任务的回复，因此让它在当前CPU上紧接着运行。
+        // 如果本任务正在使用对方借出的CPU时间，则将剩余部分归还给对方。
+        unsigned quantum = 0;
+        if (current->donor == dst->tid) {
+            quantum = current->quantum;
+            current->quantum = 0;
+        }
+
+        task_handoff(dst, quantum);
+    } else {
+        task_resume(dst);
+    }
+
+    if (is_reply && current->donor == dst->tid) {
+        current->donor = 0;
+    }
+}
+
+// 检查接收方是否正在等待本任务的消息。异步消息只能直接交付给开放接收（非内核）中的
+// 任务，否则放入邮箱：调用的回复和寻呼任务的回复等封闭接收必须来自同步的发送。
+static bool is_ready(struct task *dst, struct task *current, unsigned flags) {
+    if (dst->state != TASK_BLOCKED) {
+        return false;
+    }
+
+    if (flags & IPC_ASYNC) {
+        return dst->ipc_open_recv;
+    }
+
+    return dst->wait_for == IPC_ANY || dst->wait_for == current->tid;
+}
+
+// 检查用户空间的区域是否全部已映射且可读取。已映射的区域在复制时不会发生页面错误，
+// 因此不会阻塞。
+static bool is_user_mapped(struct task *task, uaddr_t uaddr, size_t len) {
+    if (len == 0) {
+        return true;
+    }
+
+    if (uaddr + len < uaddr || !arch_is_mappable_uaddr(uaddr)
+        || !arch_is_mappable_uaddr(uaddr + len - 1)) {
+        return false;
+    }
+
+    for (uaddr_t page = ALIGN_DOWN(uaddr, PAGE_SIZE); page < uaddr + len;
+         page += PAGE_SIZE) {
+        unsigned attrs;
+        if (!arch_vm_lookup(&task->process->vm, page, &attrs)
+            || (attrs & (PAGE_USER | PAGE_READABLE))
+                   != (PAGE_USER | PAGE_READABLE)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// 将用户空间的消息直接复制到接收方登记的消息缓冲区。接收方可能在等待任何任务的消息，
+// 因此复制过程中不能阻塞：如果消息所在的页面尚未映射（会发生页面错误），或者附带了
+// out-of-line缓冲区（移动页面时可能阻塞），则返回 false，改用通常的路径。
+static bool copy_direct(struct task *dst, __user const struct message *m,
+                        int type) {
+    struct task *current = CURRENT_TASK;
+    struct message *buf = dst->ipc_buffer;
+    size_t fixed_len = msg_fixed_len(type);
+    if (!is_user_mapped(current, (uaddr_t) m, fixed_len)
+        || memcpy_from_user(buf, m, fixed_len) != OK || buf->type != type) {
+        return false;
+    }
+
+    uaddr_t *ool_uaddr;
+    size_t *ool_len;
+    if (msg_ool(buf, &ool_uaddr, &ool_len) && *ool_len > 0) {
+        return false;
+    }
+
+    size_t len = msg_len(buf);
+    return is_user_mapped(current, (uaddr_t) m + fixed_len, len - fixed_len)
+           && memcpy_from_user((uint8_t *) buf + fixed_len,
+                               (__user const uint8_t *) m + fixed_len,
+                               len - fixed_len)
+                  == OK;
+}
+
+// 接收方已经在等待本任务的消息：发送消息并恢复接收方。
+static error_t deliver_message(struct task *dst, struct message *m,
+                               unsigned flags) {
+    // 移动out-of-line缓冲区的页面。接收方已经在等待本任务的消息，因此即使失败也要
+    // 将错误作为消息发送给它，以免它一直等待下去。
+    uaddr_t *ool_uaddr;
+    size_t *ool_len;
+    error_t ool_err = OK;
+    if (!(flags & IPC_KERNEL) && msg_ool(m, &ool_uaddr, &ool_len)
+        && *ool_len > 0) {
+        ool_err = move_ool(dst, ool_uaddr, *ool_len);
+        if (ool_err != OK) {
+            m->type = ool_err;
+        }
+    }
+
+    // 发送消息并恢复目标任务
+    memcpy(&dst->m, m, msg_len(m));
+    dst->m.src = (flags & IPC_KERNEL) ? FROM_KERNEL : CURRENT_TASK->tid;
+    wake_receiver(dst, flags);
+    return ool_err;
+}
+
+// 在发送队列中等待的任务恢复后的发送处理。等待期间消息保存在 current->m 中。
+static error_t resume_send(struct task *dst, unsigned flags) {
+    struct task *current = CURRENT_TASK;
+    current->ipc_cancelable = false;
+
+    // 超时: ipc_expire函数已经将本任务从发送队列中删除
+    if (current->ipc_canceled) {
+        current->ipc_canceled = false;
+        return ERR_TIMEOUT;
+    }
+
+    // 如果目标任务完成则中断发送过程
+    if (current->notifications & NOTIFY_ABORTED) {
+        current->notifications &= ~NOTIFY_ABORTED;
+        return ERR_ABORTED;
+    }
+
+    return deliver_message(dst, &current->m, flags);
+}
+
+static error_t recv_message(task_t src, __user struct message *m,
+                            unsigned flags);
+static error_t send_result(struct task *dst, error_t err, unsigned flags);
+
+// 以续体恢复的发送等待。完成发送后，如果需要则继续进行接收处理。
+__noreturn static void send_continue(void) {
+    struct task *current = CURRENT_TASK;
+    struct task *dst = current->cont_dst;
+    unsigned flags = current->cont_flags;
+    error_t err = send_result(dst, resume_send(dst, flags), flags);
+    if (err == OK && (flags & IPC_RECV)) {
+        err = recv_message(current->cont_src, current->cont_m, flags);
+    }
+
+    current->cont_done(err);
+}
+
+// 消息发送流程。如果请求被分派给了服务的工作任务，并且接下来要接收目标任务的回复，
+// 则将 *src 改为实际的目标任务。
+static error_t send_message(struct task *dst, task_t *src,
+                            __user struct message *m, unsigned flags) {
     // 我无法给自己发送消息
     struct task *current = CURRENT_TASK;
     if (dst == current) {
@@ -19,21 +376,76 @@ static error_t send_message(struct task *dst, __user struct message *m,
 
     // 复制您要发送的消息。用户指针情况下可能出现页面错误
     // 请注意，有
+    // 用户空间的消息先只复制消息头，以便决定目标任务。
     struct message copied_m;
-    if (flags & IPC_KERNEL) {
-        memcpy(&copied_m, (struct message *) m, sizeof(struct message));
+    bool from_user = !(flags & (IPC_KERNEL | IPC_FAST));
+    if (from_user) {
+        error_t err = memcpy_from_user(&copied_m, m, MESSAGE_HEADER_LEN);
+        if (err != OK) {
+            return err;
+        }
     } else {
-        error_t err = memcpy_from_user(&copied_m, m, sizeof(struct message));
+        memcpy(&copied_m, (struct message *) m,
+               msg_len((struct message *) m));
+    }
+
+    // 发往服务的请求分派给其中一个工作任务。回复和异步消息的查询 (ASYNC_RECV_MSG)
+    // 是发给特定任务的，因此不分派。
+    if (!(flags & (IPC_KERNEL | IPC_REPLY)) && copied_m.type != ASYNC_RECV_MSG) {
+        struct task *routed = dispatch(dst);
+        if (*src == dst->tid) {
+            // 调用被分派给了工作任务，因此接收该工作任务的回复
+            *src = routed->tid;
+        }
+
+        dst = routed;
+    }
+
+    // 单次复制: 接收方已经在用登记的消息缓冲区等待本任务的消息，则将消息直接复制
+    // 到那里，不经过内核中的临时缓冲区。
+    if (from_user && is_ready(dst, current, flags) && dst->ipc_buffer_recv
+        && copy_direct(dst, m, copied_m.type)) {
+        dst->ipc_buffer->src = current->tid;
+        dst->ipc_buffer_filled = true;
+        wake_receiver(dst, flags);
+        return OK;
+    }
+
+    if (from_user) {
+        error_t err = copy_message_from_user(&copied_m, m);
+        if (err != OK) {
+            return err;
+        }
+    }
+
+    // 检查是否附带了out-of-line缓冲区。页面的移动在对方进入接收状态后进行。
+    uaddr_t *ool_uaddr;
+    size_t *ool_len;
+    bool has_ool = !(flags & IPC_KERNEL)
+                   && msg_ool(&copied_m, &ool_uaddr, &ool_len) && *ool_len > 0;
+    if (has_ool) {
+        error_t err = prepare_ool(*ool_uaddr, *ool_len);
         if (err != OK) {
             return err;
         }
     }
 
     // 检查收件人是否正在等待您的消息
-    bool ready = dst->state == TASK_BLOCKED
-                 && (dst->wait_for == IPC_ANY || dst->wait_for == current->tid);
-    if (!ready) {
-        if (flags & IPC_NOBLOCK) {
+    if (!is_ready(dst, current, flags)) {
+        // 异步发送 (IPC_ASYNC): 不等待对方，将消息放入对方的邮箱。页面的移动需要
+        // 对方的接收窗口，因此不能异步发送out-of-line缓冲区。
+        if (flags & IPC_ASYNC) {
+            if (has_ool) {
+                return ERR_INVALID_ARG;
+            }
+
+            return mailbox_push(dst, &copied_m,
+                                (flags & IPC_KERNEL) ? FROM_KERNEL
+                                                     : current->tid);
+        }
+
+        // 回复 (IPC_REPLY) 与IPC_NOBLOCK一样不等待对方进入接收状态
+        if (flags & (IPC_NOBLOCK | IPC_REPLY)) {
             return ERR_WOULD_BLOCK;
         }
 
@@ -49,25 +461,82 @@ static error_t send_message(struct task *dst, __user struct message *m,
             }
         }
 
-        // 将正在运行的任务添加到目标的发送队列并将其置于阻塞状态
+        // 已经超时则不再等待
+        bool cancelable = !(flags & IPC_KERNEL);
+        if (cancelable && current->ipc_expired) {
+            return ERR_TIMEOUT;
+        }
+
+        // 调用 (IPC_CALL): 目标任务正在忙于其他处理。将本任务在运行队列中的位置和
+        // 剩余CPU时间借给它，以免请求排在无关的任务之后。
+        if ((flags & IPC_RECV) && !(flags & IPC_REPLY)) {
+            task_lend(dst, current);
+        }
+
+        // 将正在运行的任务添加到目标的发送队列并将其置于阻塞状态。等待期间消息
+        // 保存在 current->m 中：发送等待中的任务不会接收消息，不会被改写。
         list_push_back(&dst->senders, &current->waitqueue_next);
         task_block(current);
+        memcpy(&current->m, &copied_m, msg_len(&copied_m));
+        current->ipc_cancelable = cancelable;
 
         // 将 CPU 让给其他任务。当目标任务处于接收状态时，该任务将恢复。
+        if (flags & IPC_CONTINUE) {
+            current->cont_dst = dst;
+            current->cont_src = *src;
+            current->cont_m = m;
+            current->cont_flags = flags;
+            task_switch_continue(send_continue);
+        }
+
         task_switch();
+        return resume_send(dst, flags);
+    }
 
-        // 如果目标任务完成则中断发送过程
-        if (current->notifications & NOTIFY_ABORTED) {
-            current->notifications &= ~NOTIFY_ABORTED;
-            return ERR_ABORTED;
-        }
+    return deliver_message(dst, &copied_m, flags);
+}
+
+//复制收到的消息。用户指针情况下可能出现页面错误
+static error_t copy_to_receiver(__user struct message *m,
+                                struct message *copied_m, unsigned flags) {
+    size_t len = msg_len(copied_m);
+    if (flags & (IPC_KERNEL | IPC_FAST)) {
+        memcpy((void *) m, copied_m, len);
+        return OK;
     }
 
-    // 发送消息并恢复目标任务
-    memcpy(&dst->m, &copied_m, sizeof(struct message));
-    dst->m.src = (flags & IPC_KERNEL) ? FROM_KERNEL : current->tid;
-    task_resume(dst);
-    return OK;
+    return memcpy_to_user(m, copied_m, len);
+}
+
+// 在接收状态下等待的任务恢复后的接收处理。
+static error_t resume_recv(__user struct message *m, unsigned flags) {
+    struct task *current = CURRENT_TASK;
+    current->ipc_cancelable = false;
+    current->ipc_buffer_recv = false;
+
+    //收到消息
+    current->wait_for = IPC_DENY;
+    current->ipc_open_recv = false;
+    if (current->ipc_canceled) {
+        current->ipc_canceled = false;
+        return ERR_TIMEOUT;
+    }
+
+    //发送方已经将消息直接写入了消息缓冲区，不需要再复制
+    if (current->ipc_buffer_filled) {
+        current->ipc_buffer_filled = false;
+        return OK;
+    }
+
+    struct message copied_m;
+    memcpy(&copied_m, &current->m, msg_len(&current->m));
+    return copy_to_receiver(m, &copied_m, flags);
+}
+
+// 以续体恢复的接收等待
+__noreturn static void recv_continue(void) {
+    struct task *current = CURRENT_TASK;
+    current->cont_done(resume_recv(current->cont_m, current->cont_flags));
 }
 
 // 消息接收处理
@@ -77,16 +546,18 @@ static error_t recv_message(task_t src, __user struct message *m,
     struct message copied_m;
     if (src == IPC_ANY && current->notifications) {
         //以消息形式接收通知（如果有）
-        copied_m.type = NOTIFY_MSG;
-        copied_m.src = FROM_KERNEL;
-        copied_m.notify.notifications = current->notifications;
-        current->notifications = 0;
+        build_notify_message(current, &copied_m);
+    } else if (src == IPC_ANY && !(flags & IPC_KERNEL)
+               && mailbox_pop(current, &copied_m)) {
+        //邮箱中有异步消息，不需要等待发送方。只在开放接收中取出，以免被当作调用的
+        //回复等封闭接收的消息。
     } else {
         if (flags & IPC_NOBLOCK) {
             return ERR_WOULD_BLOCK;
         }
 
         //如果发送队列中有匹配`src`的任务，则重新启动它
+        bool cancelable = !(flags & IPC_KERNEL);
         LIST_FOR_EACH (sender, &current->senders, struct task, waitqueue_next) {
             if (src == IPC_ANY || src == sender->tid) {
                 DEBUG_ASSERT(sender->state == TASK_BLOCKED);
@@ -94,40 +565,62 @@ static error_t recv_message(task_t src, __user struct message *m,
                 list_remove(&sender->waitqueue_next);
                 task_resume(sender);
                 src = sender->tid;
+                //发送方已经开始发送，因此即使超时也要等待它的消息
+                cancelable = false;
                 break;
             }
         }
 
+        if (cancelable && current->ipc_expired) {
+            return ERR_TIMEOUT;
+        }
+
+        //如果在登记的消息缓冲区中接收，则发送方可以将消息直接写入那里
+        current->ipc_buffer_recv =
+            current->ipc_buffer && !(flags & (IPC_KERNEL | IPC_FAST))
+            && (uaddr_t) m == current->ipc_buffer_uaddr;
+
         //等待收到消息
         current->wait_for = src;
+        current->ipc_open_recv = src == IPC_ANY && !(flags & IPC_KERNEL);
         task_block(current);
-        task_switch();
+        current->ipc_cancelable = cancelable;
+        if (flags & IPC_CONTINUE) {
+            current->cont_m = m;
+            current->cont_flags = flags;
+            task_switch_continue(recv_continue);
+        }
 
-        //收到消息
-        current->wait_for = IPC_DENY;
-        memcpy(&copied_m, &current->m, sizeof(struct message));
+        task_switch();
+        return resume_recv(m, flags);
     }
 
-    //复制收到的消息。用户指针情况下可能出现页面错误
-//请注意，有
-    if (flags & IPC_KERNEL) {
-        memcpy((void *) m, &copied_m, sizeof(struct message));
-    } else {
-        error_t err = memcpy_to_user(m, &copied_m, sizeof(struct message));
-        if (err != OK) {
-            return err;
-        }
+    return copy_to_receiver(m, &copied_m, flags);
+}
+
+// 发送的结果。回复并接收时，与ipc_reply函数一样，回复失败时丢弃回复并继续进行
+// 接收处理（返回 OK）。否则服务器将无法接收下一个请求。
+static error_t send_result(struct task *dst, error_t err, unsigned flags) {
+    if (err == OK || !(flags & IPC_REPLY) || !(flags & IPC_RECV)) {
+        return err;
     }
 
+    WARN("%s: failed to reply to %s (#%d): %s", CURRENT_TASK->name, dst->name,
+         dst->tid, err2str(err));
     return OK;
 }
 
 //发送和接收消息。
+//
+//指定 IPC_CONTINUE 时，需要等待的话不保留内核栈：调用方的栈帧被丢弃，IPC结束后以
+//其结果调用 CURRENT_TASK->cont_done（不返回）。不需要等待时与通常一样返回。
 error_t ipc(struct task *dst, task_t src, __user struct message *m,
             unsigned flags) {
+    DEBUG_ASSERT(!(flags & IPC_CONTINUE) || CURRENT_TASK->cont_done);
+
     //发送操作
     if (flags & IPC_SEND) {
-        error_t err = send_message(dst, m, flags);
+        error_t err = send_result(dst, send_message(dst, &src, m, flags), flags);
         if (err != OK) {
             return err;
         }
@@ -135,10 +628,7 @@ error_t ipc(struct task *dst, task_t src, __user struct message *m,
 
     //接收操作
     if (flags & IPC_RECV) {
-        error_t err = recv_message(src, m, flags);
-        if (err != OK) {
-            return err;
-        }
+        return recv_message(src, m, flags);
     }
 
     return OK;
@@ -149,13 +639,54 @@ void notify(struct task *dst, notifications_t notifications) {
     if (dst->state == TASK_BLOCKED && dst->wait_for == IPC_ANY) {
         //目标任务正在等待打开接收状态。在发送 NOTIFY_MSG 消息的正文中
 //立即发送通知。
-        dst->m.type = NOTIFY_MSG;
-        dst->m.src = FROM_KERNEL;
-        dst->m.notify.notifications = dst->notifications | notifications;
-        dst->notifications = 0;
+        dst->notifications |= notifications;
+        build_notify_message(dst, &dst->m);
         task_resume(dst);
     } else {
         //保留通知，直到目标任务打开接收。
         dst->notifications |= notifications;
     }
 }
+
+//发送异步通知 (NOTIFY_ASYNC)。记录发送方，以便接收方知道该向哪个任务查询。
+void notify_async(struct task *dst, struct task *src) {
+    unsigned index = TASK_INDEX(src->tid) - 1;
+    unsigned word = index / 32;
+    dst->async_pending[word] |= 1u << (index % 32);
+    dst->async_summary |= 1u << word;
+    notify(dst, NOTIFY_ASYNC);
+}
+
+//从所有任务中删除 src 发送的异步通知。任务表的索引会被新任务重复使用，如果留下
+//旧的位，接收方会把新任务误认为发送方。
+void forget_async_source(struct task *src) {
+    unsigned index = TASK_INDEX(src->tid) - 1;
+    unsigned word = index / 32;
+    uint32_t mask = 1u << (index % 32);
+    LIST_FOR_EACH (task, &active_tasks, struct task, next) {
+        if (task->async_pending[word] & mask) {
+            task->async_pending[word] &= ~mask;
+            if (!task->async_pending[word]) {
+                task->async_summary &= ~(1u << word);
+            }
+        }
+    }
+}
+
+//IPC超时。如果任务正在发送/接收中等待，则中断等待并让它返回 ERR_TIMEOUT。
+//任务不在等待中时，只记录超时，下次等待前返回 ERR_TIMEOUT。
+void ipc_expire(struct task *task) {
+    task->ipc_expired = true;
+    if (task->state != TASK_BLOCKED || !task->ipc_cancelable) {
+        return;
+    }
+
+    //如果正在等待发送，则从目标任务的发送队列中删除
+    if (task->wait_for == IPC_DENY) {
+        list_remove(&task->waitqueue_next);
+    }
+
+    task->ipc_cancelable = false;
+    task->ipc_canceled = true;
+    task_resume(task);
+}
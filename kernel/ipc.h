@@ -6,3 +6,6 @@ struct message;
 error_t ipc(struct task *dst, task_t src, __user struct message *m,
             unsigned flags);
 void notify(struct task *dst, notifications_t notifications);
+void notify_async(struct task *dst, struct task *src);
+void forget_async_source(struct task *src);
+void ipc_expire(struct task *task);
@@ -3,6 +3,7 @@
 #include "memory.h"
 #include "printk.h"
 #include "task.h"
+#include "timer.h"
 #include <libs/common/elf.h>
 #include <libs/common/string.h>
 
@@ -70,6 +71,7 @@ static void create_first_task(struct bootinfo *bootinfo) {
 __noreturn static void idle_task(void) {
     for (;;) {
         task_switch();
+        timer_reprogram();
         arch_idle();
     }
 }
@@ -80,6 +82,7 @@ void kernel_main(struct bootinfo *bootinfo) {
     printf("Booting HinaOS...\n");
     memory_init(bootinfo);
     arch_init();
+    timer_init_wheel();
     task_init_percpu();
     create_first_task(bootinfo);
     arch_init_percpu();
@@ -61,6 +61,10 @@ static bool is_contiguously_free(struct memory_zone *zone, size_t start,
 //-PM_ALLOC_ZEROED：将物理页清零
 //-PM_ALLOC_ALIGNED：返回按大小对齐的物理内存地址
 paddr_t pm_alloc(size_t size, struct task *owner, unsigned flags) {
+    if (owner) {
+        owner = owner->process;//线程的内存页属于共享地址空间的主线程
+    }
+
     size_t aligned_size = ALIGN_UP(size, PAGE_SIZE);//实际分配的大小
     size_t num_pages = aligned_size / PAGE_SIZE;//要分配的物理页数
     LIST_FOR_EACH (zone, &zones, struct memory_zone, next) {
@@ -122,6 +126,7 @@ static void free_page(struct page *page) {
 //将被减去。我想为一个任务分配一个物理页，但该任务还没有初始化。
 //未完成时使用。
 void pm_own_page(paddr_t paddr, struct task *owner) {
+    owner = owner->process;
     struct page *page = find_page_by_paddr(paddr, NULL);
 
     ASSERT(page != NULL);
@@ -146,16 +151,68 @@ void pm_free(paddr_t paddr, size_t size) {
     }
 }
 
+//释放 owner 任务拥有的、没有被映射的物理内存区域。只有所有页面都是 owner 任务的RAM
+//页面并且只剩分配时的引用时才释放，否则什么也不做并返回 ERR_NOT_ALLOWED。
+error_t pm_free_unmapped(struct task *owner, paddr_t paddr, size_t size) {
+    DEBUG_ASSERT(IS_ALIGNED(paddr, PAGE_SIZE));
+    DEBUG_ASSERT(IS_ALIGNED(size, PAGE_SIZE));
+
+    owner = owner->process;
+    for (size_t offset = 0; offset < size; offset += PAGE_SIZE) {
+        enum memory_zone_type zone_type;
+        struct page *page = find_page_by_paddr(paddr + offset, &zone_type);
+        if (!page || zone_type != MEMORY_ZONE_FREE || page->owner != owner
+            || page->ref_count != 1) {
+            return ERR_NOT_ALLOWED;
+        }
+    }
+
+    pm_free(paddr, size);
+    return OK;
+}
+
 //将列表指定为 Pm free 函数的参数的版本。
 void pm_free_by_list(list_t *pages) {
     LIST_FOR_EACH (page, pages, struct page, next) {
         free_page(page);
+
+        //仍被映射到其他任务的页面（共享内存）成为没有所有者的页面。剩下的每个映射
+        //被取消（vm_unmap）或映射它的任务结束（arch_vm_destroy）时，arch层通过
+        //pm_free 减去该映射的引用，最后一个映射被取消时引用计数变为0而被释放。
+        if (page->ref_count > 0) {
+            list_remove(&page->next);
+            page->owner = NULL;
+        }
     }
 }
 
-//将页面映射（添加到页表）到指定的物理地址。
+//固定任务的虚拟地址上映射的页面，使内核可以通过物理地址直接访问它。即使任务取消了
+//映射，页面在调用 pm_free 函数解除固定之前也不会被释放。返回页面的物理地址，无法
+//固定（未映射、不可写或不是RAM）时返回 0。
+paddr_t vm_pin_page(struct task *task, uaddr_t uaddr) {
+    DEBUG_ASSERT(IS_ALIGNED(uaddr, PAGE_SIZE));
+
+    unsigned attrs;
+    paddr_t paddr = arch_vm_lookup(&task->process->vm, uaddr, &attrs);
+    if (!paddr || (attrs & PAGE_WRITABLE) == 0) {
+        return 0;
+    }
+
+    enum memory_zone_type zone_type;
+    struct page *page = find_page_by_paddr(paddr, &zone_type);
+    if (!page || zone_type != MEMORY_ZONE_FREE || page->ref_count == 0) {
+        return 0;
+    }
+
+    page->ref_count++;
+    return paddr;
+}
+
+//将页面映射（添加到页表）到指定的物理地址。线程的地址空间是主线程的地址空间。
 error_t vm_map(struct task *task, uaddr_t uaddr, paddr_t paddr,
                unsigned attrs) {
+    task = task->process;
+
     //从物理地址获取页管理结构。
     enum memory_zone_type zone_type;
     struct page *page = find_page_by_paddr(paddr, &zone_type);
@@ -178,7 +235,11 @@ error_t vm_map(struct task *task, uaddr_t uaddr, paddr_t paddr,
 //
 //1) 其页面由任务拥有的任务
 //2）页面所属任务的寻呼任务
-            if (page->owner != task && page->owner->pager != task) {
+//3）调用者同时是页面所属任务和该任务的寻呼任务（寻呼任务建立共享内存）
+            if (!page->owner
+                || (page->owner != task && page->owner->pager != task
+                    && (page->owner->pager != CURRENT_TASK->process
+                        || task->pager != CURRENT_TASK->process))) {
                 WARN("%s: vm_map: paddr %p is not owned", task->name, paddr);
                 return ERR_INVALID_PADDR;
             }
@@ -201,7 +262,7 @@ error_t vm_map(struct task *task, uaddr_t uaddr, paddr_t paddr,
     }
 
     //对于Mmio区域，将任务注册为所有者。如果是ram区域，则已经使用pm alloc函数注册了。
-    if (zone_type == MEMORY_ZONE_MMIO && task) {
+    if (zone_type == MEMORY_ZONE_MMIO) {
         list_push_back(&task->pages, &page->next);
     }
 
@@ -209,13 +270,14 @@ error_t vm_map(struct task *task, uaddr_t uaddr, paddr_t paddr,
     return OK;
 }
 
-//取消映射（从页表中删除）页面。
+//取消映射（从页表中删除）页面。arch_vm_unmap 通过 pm_free 减去该映射的引用，所以
+//所有者已经结束的共享页面在最后一个映射被取消时在这里被释放。
 error_t vm_unmap(struct task *task, uaddr_t uaddr) {
     if (!arch_is_mappable_uaddr(uaddr)) {
         return ERR_INVALID_ARG;
     }
 
-    error_t err = arch_vm_unmap(&task->vm, uaddr);
+    error_t err = arch_vm_unmap(&task->process->vm, uaddr);
     if (err != OK) {
         return err;
     }
@@ -223,8 +285,118 @@ error_t vm_unmap(struct task *task, uaddr_t uaddr) {
     return OK;
 }
 
+//将src任务中从src_uaddr开始的size字节的页面移动（而不是复制）到dst任务的dst_uaddr。
+//被移动的物理页面的所有者变为dst任务。
+//
+//dst任务在移动目标地址上原有的页面被清零后交给src任务，填补被移走的页面。因此
+//重复使用同一缓冲区和接收窗口时，双方都不需要重新分配页面（也不会发生页面错误）。
+//
+//只能移动src任务独占的、可写的RAM页面。MMIO区域和共享的页面不能移动。
+error_t vm_move_pages(struct task *src, uaddr_t src_uaddr, struct task *dst,
+                      uaddr_t dst_uaddr, size_t size) {
+    DEBUG_ASSERT(IS_ALIGNED(src_uaddr, PAGE_SIZE));
+    DEBUG_ASSERT(IS_ALIGNED(dst_uaddr, PAGE_SIZE));
+    DEBUG_ASSERT(IS_ALIGNED(size, PAGE_SIZE));
+
+    src = src->process;
+    dst = dst->process;
+
+    //首先检查所有页面是否都可以移动，以免移动到一半时失败
+    for (offset_t offset = 0; offset < size; offset += PAGE_SIZE) {
+        unsigned attrs;
+        paddr_t paddr = arch_vm_lookup(&src->vm, src_uaddr + offset, &attrs);
+        if (!paddr) {
+            return ERR_INVALID_UADDR;
+        }
+
+        enum memory_zone_type zone_type;
+        struct page *page = find_page_by_paddr(paddr, &zone_type);
+        if (!page || zone_type != MEMORY_ZONE_FREE || page->owner != src
+            || page->ref_count != 2 || (attrs & PAGE_WRITABLE) == 0) {
+            WARN("%s: vm_move_pages: page at %p is not movable", src->name,
+                 src_uaddr + offset);
+            return ERR_NOT_ALLOWED;
+        }
+    }
+
+    for (offset_t offset = 0; offset < size; offset += PAGE_SIZE) {
+        uaddr_t src_page_uaddr = src_uaddr + offset;
+        uaddr_t dst_page_uaddr = dst_uaddr + offset;
+        unsigned attrs;
+        paddr_t paddr = arch_vm_lookup(&src->vm, src_page_uaddr, &attrs);
+        paddr_t old_paddr = arch_vm_lookup(&dst->vm, dst_page_uaddr, &attrs);
+
+        //dst任务原有的页面是否是dst任务独占的RAM页面（分配时的引用和dst任务的映射
+        //这两个引用）。只有这种页面清零后交给src任务。其他任务还在使用的页面只取消
+        //映射，src任务下次访问时由寻呼任务重新分配页面。
+        enum memory_zone_type zone_type;
+        struct page *old_page =
+            old_paddr ? find_page_by_paddr(old_paddr, &zone_type) : NULL;
+        bool give_back = old_page && zone_type == MEMORY_ZONE_FREE
+                         && old_page->owner == dst
+                         && old_page->ref_count == 2;
+
+        //取消映射dst任务原有的页面（arch_vm_unmap 减去该映射的引用）。此时页表已经
+        //存在，因此之后在同一地址上的映射不会失败。
+        if (old_paddr) {
+            ASSERT_OK(arch_vm_unmap(&dst->vm, dst_page_uaddr));
+        }
+
+        //先映射到dst任务再从src任务取消映射，这样即使映射失败也只需中断处理。映射
+        //从src任务转移到dst任务，因此引用计数不变（分配时的引用和一个映射）。
+        error_t err = arch_vm_map(&dst->vm, dst_page_uaddr, paddr,
+                                  PAGE_READABLE | PAGE_WRITABLE | PAGE_USER);
+        if (err != OK) {
+            return err;
+        }
+
+        struct page *page = find_page_by_paddr(paddr, NULL);
+        page->ref_count++;
+        ASSERT_OK(arch_vm_unmap(&src->vm, src_page_uaddr));
+        DEBUG_ASSERT(page->ref_count == 2);
+        list_remove(&page->next);
+        page->owner = dst;
+        list_push_back(&dst->pages, &page->next);
+
+        if (!give_back) {
+            continue;
+        }
+
+        //将dst任务原有的页面清零后交给src任务。这里也是映射的转移，引用计数回到2。
+        //因此重复接收到同一窗口时，双方的页面数都不会增加。
+        memset((void *) arch_paddr_to_vaddr(old_paddr), 0, PAGE_SIZE);
+        list_remove(&old_page->next);
+        old_page->owner = src;
+        list_push_back(&src->pages, &old_page->next);
+        ASSERT_OK(arch_vm_map(&src->vm, src_page_uaddr, old_paddr,
+                              PAGE_READABLE | PAGE_WRITABLE | PAGE_USER));
+        old_page->ref_count++;
+        DEBUG_ASSERT(old_page->ref_count == 2);
+    }
+
+    return OK;
+}
+
+//检查寻呼任务的响应消息是否正确
+static void check_pager_reply(error_t err, struct message *m) {
+    if (err != OK || m->type != PAGE_FAULT_REPLY_MSG) {
+        task_exit(EXP_INVALID_PAGER_REPLY);
+    }
+}
+
+//以续体恢复的页面错误处理的结束处理。回复消息在 current->m 中。
+__noreturn static void page_fault_done(error_t err) {
+    check_pager_reply(err, &CURRENT_TASK->m);
+    arch_return_to_user();
+}
+
 //页面错误处理程序
-void handle_page_fault(vaddr_t vaddr, vaddr_t ip, unsigned fault) {
+//
+//continuable 为 true 时（用户模式下发生的页面错误），等待寻呼任务的回复期间不保留
+//内核栈，处理完成后直接返回用户模式（不返回）。复制用户指针时发生的页面错误需要
+//返回到原来的内核处理，因此指定 false。
+void handle_page_fault(vaddr_t vaddr, vaddr_t ip, unsigned fault,
+                       bool continuable) {
     //内核中没有发生页面错误
 //（复制用户指针内存时设置PAGE_FAULT_USER）
     if ((fault & PAGE_FAULT_USER) == 0) {
@@ -234,33 +406,38 @@ void handle_page_fault(vaddr_t vaddr, vaddr_t ip, unsigned fault) {
 
     //检查发生缺页的地址是否是可映射地址
 //（NULL页和内核区地址无法映射）
+    struct task *current = CURRENT_TASK;
     if (!arch_is_mappable_uaddr(vaddr)) {
         WARN("%s: page fault at unmappable vaddr: vaddr=%p, ip=%p",
-             CURRENT_TASK->name, vaddr, ip);
+             current->name, vaddr, ip);
         task_exit(EXP_INVALID_UADDR);
     }
 
     //空闲任务和第一个用户任务不会发生页面错误
-    struct task *pager = CURRENT_TASK->pager;
+    struct task *pager = current->pager;
     if (!pager) {
-        PANIC("%s: unexpected page fault: vaddr=%p, ip=%p", CURRENT_TASK->name,
+        PANIC("%s: unexpected page fault: vaddr=%p, ip=%p", current->name,
               vaddr, ip);
     }
 
-    //向寻呼任务发送缺页处理请求消息并等待回复
-    struct message m;
-    m.type = PAGE_FAULT_MSG;
-    m.page_fault.task = CURRENT_TASK->tid;
-    m.page_fault.uaddr = vaddr;
-    m.page_fault.ip = ip;
-    m.page_fault.fault = fault;
-    error_t err = ipc(pager, pager->tid, (__user struct message *) &m,
-                      IPC_CALL | IPC_KERNEL);
-
-    //检查寻呼任务的响应消息是否正确
-    if (err != OK || m.type != PAGE_FAULT_REPLY_MSG) {
-        task_exit(EXP_INVALID_PAGER_REPLY);
+    //向寻呼任务发送缺页处理请求消息并等待回复。可以使用续体时，消息放在
+    //current->m 中，以免依赖内核栈上的变量。
+    struct message local_m;
+    struct message *m = continuable ? &current->m : &local_m;
+    m->type = PAGE_FAULT_MSG;
+    m->page_fault.task = current->tid;
+    m->page_fault.uaddr = vaddr;
+    m->page_fault.ip = ip;
+    m->page_fault.fault = fault;
+
+    unsigned flags = IPC_CALL | IPC_KERNEL;
+    if (continuable) {
+        current->cont_done = page_fault_done;
+        flags |= IPC_CONTINUE;
     }
+
+    error_t err = ipc(pager, pager->tid, (__user struct message *) m, flags);
+    check_pager_reply(err, m);
 }
 
 //初始化内存管理系统
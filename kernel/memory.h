@@ -33,9 +33,14 @@ paddr_t pm_alloc(size_t size, struct task *owner, unsigned flags);
 void pm_own_page(paddr_t paddr, struct task *owner);
 void pm_free(paddr_t paddr, size_t size);
 void pm_free_by_list(list_t *pages);
+error_t pm_free_unmapped(struct task *owner, paddr_t paddr, size_t size);
 error_t vm_map(struct task *task, uaddr_t uaddr, paddr_t paddr, unsigned attrs);
 error_t vm_unmap(struct task *task, uaddr_t uaddr);
-void handle_page_fault(uaddr_t uaddr, vaddr_t ip, unsigned fault);
+paddr_t vm_pin_page(struct task *task, uaddr_t uaddr);
+error_t vm_move_pages(struct task *src, uaddr_t src_uaddr, struct task *dst,
+                      uaddr_t dst_uaddr, size_t size);
+void handle_page_fault(uaddr_t uaddr, vaddr_t ip, unsigned fault,
+                       bool continuable);
 
 struct bootinfo;
 void memory_init(struct bootinfo *bootinfo);
@@ -47,27 +47,26 @@ void handle_serial_interrupt(void) {
 }
 
 // UARTからの入力を読み込む。QEMUは標準入力 (一般にキーボード入力) がUARTに繋がっている。
+//
+// システムコールからのみ呼ばれる。1文字も読み込めなかった場合はカーネルスタックを
+// 保持せずにブロックし、UARTからの割り込みで再開したらシステムコールを最初からやり直す。
 int serial_read(char *buf, int max_len) {
+    // バッファに貯まったデータを全て読み込む
     int len = 0;
-    while (true) {
-        // バッファに貯まったデータを全て読み込む
-        for (; len < max_len && input_rp != input_wp; len++) {
-            char ch = input[input_rp];
-            input_rp = (input_rp + 1) % sizeof(input);
-            buf[len] = ch;
-        }
-
-        // 1文字以上読み込めたら、それを即座に返す
-        if (len > 0) {
-            break;
-        }
+    for (; len < max_len && input_rp != input_wp; len++) {
+        char ch = input[input_rp];
+        input_rp = (input_rp + 1) % sizeof(input);
+        buf[len] = ch;
+    }
 
-        // 1文字も読み込めなかったら、タスクをブロックしてUARTからの割り込みを待つ
+    // 1文字も読み込めなかったら、タスクをブロックしてUARTからの割り込みを待つ
+    if (len == 0) {
         list_push_back(&serial_readers, &CURRENT_TASK->waitqueue_next);
         task_block(CURRENT_TASK);
-        task_switch();
+        task_switch_continue(arch_syscall_restart);
     }
 
+    // 1文字以上読み込めたら、それを即座に返す
     return len;
 }
 
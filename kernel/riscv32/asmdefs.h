@@ -7,8 +7,8 @@
 // struct arch_cpuvarのメンバ変数のオフセット
 #define CPUVAR_SSCRATCH  0
 #define CPUVAR_SP_TOP    4
-#define CPUVAR_MSCRATCH0 8
-#define CPUVAR_MSCRATCH1 12
-#define CPUVAR_MTIMECMP  16
-#define CPUVAR_MTIME     20
-#define CPUVAR_INTERVAL  24
+#define CPUVAR_FRAME     8
+#define CPUVAR_MSCRATCH0 12
+#define CPUVAR_MSCRATCH1 16
+#define CPUVAR_MTIMECMP  20
+#define CPUVAR_MTIME     24
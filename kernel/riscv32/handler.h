@@ -2,3 +2,5 @@
 
 void riscv32_trap_handler(void);
 void riscv32_timer_handler(void);
+struct riscv32_trap_frame;
+__noreturn void riscv32_trap_return(struct riscv32_trap_frame *frame);
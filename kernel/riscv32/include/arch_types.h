@@ -1,5 +1,6 @@
 #pragma once
 #include "../asmdefs.h"
+#include "../trap.h"
 #include <libs/common/types.h>
 
 //虚拟地址空间中内核内存区域的起始地址。
@@ -9,9 +10,9 @@
 
 //RISC V 特定任务管理结构。
 struct arch_task {
-    uint32_t sp;//下次运行时恢复的内核堆栈值
-    uint32_t sp_top;//内核栈顶
-    paddr_t sp_bottom;//内核栈底部
+    uint32_t sp;//下次运行时恢复的内核堆栈值（保留内核栈而阻塞时）
+    vaddr_t stack;//正在使用的内核栈的底部（0表示没有）
+    struct riscv32_trap_frame frame;//用户模式下发生异常/中断时的寄存器
 };
 
 //RISC v 特定的页表管理结构。
@@ -23,14 +24,13 @@ struct arch_vm {
 struct arch_cpuvar {
     uint32_t sscratch;//变量的临时存储位置
     uint32_t sp_top;//运行任务的内核栈顶
+    uint32_t frame;//运行任务的陷阱帧（struct riscv32_trap_frame）的地址
 
     //用于定时器中断处理程序（M 模式）。
     uint32_t mscratch0;//变量的临时存储位置
     uint32_t mscratch1;//变量第 2 部分的临时存储位置
     paddr_t mtimecmp;//MTIMECMP 地址
     paddr_t mtime;//MTIME地址
-    uint32_t interval;//要添加到 MTIMECMP 的值
-    uint64_t last_mtime;//最后的 mtime 值
 };
 
 //用于检查 CPUVAR_*宏定义是否正确的宏。
@@ -39,6 +39,8 @@ struct arch_cpuvar {
                   "CPUVAR_SSCRATCH is incorrect");                             \
     STATIC_ASSERT(offsetof(struct cpuvar, arch.sp_top) == CPUVAR_SP_TOP,       \
                   "CPUVAR_SP_TOP is incorrect");                               \
+    STATIC_ASSERT(offsetof(struct cpuvar, arch.frame) == CPUVAR_FRAME,         \
+                  "CPUVAR_FRAME is incorrect");                                \
     STATIC_ASSERT(offsetof(struct cpuvar, arch.mscratch0) == CPUVAR_MSCRATCH0, \
                   "CPUVAR_MSCRATCH0 is incorrect");                            \
     STATIC_ASSERT(offsetof(struct cpuvar, arch.mscratch1) == CPUVAR_MSCRATCH1, \
@@ -46,9 +48,7 @@ struct arch_cpuvar {
     STATIC_ASSERT(offsetof(struct cpuvar, arch.mtimecmp) == CPUVAR_MTIMECMP,   \
                   "CPUVAR_MTIMECMP is incorrect");                             \
     STATIC_ASSERT(offsetof(struct cpuvar, arch.mtime) == CPUVAR_MTIME,         \
-                  "CPUVAR_MTIME is incorrect");                                \
-    STATIC_ASSERT(offsetof(struct cpuvar, arch.interval) == CPUVAR_INTERVAL,   \
-                  "CPUVAR_INTERVAL is incorrect");
+                  "CPUVAR_MTIME is incorrect");
 
 //Cpuvar 宏的内容。返回当前 cpu 局部变量的地址。
 static inline struct cpuvar *arch_cpuvar_get(void) {
@@ -71,6 +71,20 @@ struct cpuvar *riscv32_cpuvar_of(int hartid) {
     return &cpuvars[hartid];
 }
 
+//获取指定cpu的cpu局部变量（与体系结构无关的接口）
+struct cpuvar *arch_cpuvar_of(int id) {
+    return riscv32_cpuvar_of(id);
+}
+
+//向指定的CPU发送处理器间中断 (IPI)。与 arch_send_ipi 不同，不等待对方处理完毕。
+void arch_send_ipi_to(int cpu, unsigned ipi) {
+    struct cpuvar *cpuvar = riscv32_cpuvar_of(cpu);
+    DEBUG_ASSERT(cpuvar->online && cpuvar != CPUVAR);
+
+    atomic_fetch_and_or(&cpuvar->ipi_pending, ipi);
+    write_setssip(cpu);
+}
+
 //向其他 CPU 发送处理器间中断 (IPI)
 void arch_send_ipi(unsigned ipi) {
     //将 ipi 发送到除您自己之外的所有 CPU
@@ -109,7 +109,6 @@ __noreturn void riscv32_boot(void) {
     cpuvar->online = false;//仍在启动
     cpuvar->id = hartid;
     cpuvar->ipi_pending = 0;
-    cpuvar->arch.interval = MTIME_PER_1MS;
     cpuvar->arch.mtimecmp = CLINT_MTIMECMP(hartid);
     cpuvar->arch.mtime = CLINT_MTIME;
 
@@ -122,12 +121,13 @@ __noreturn void riscv32_boot(void) {
     //设置一个计时器，但要确保它足够长，因为您还不想被打扰。
     *MTIMECMP = 0xffffffff;
 
-    //配置 S 模式中断处理程序和异常处理程序使用的内核堆栈。
+    //配置 S 模式中断处理程序和异常处理程序使用的内核堆栈和陷阱帧。
 //
 //然而，在启动过程完成并且第一个用户任务开始执行之前，异常和中断都会发生。
 //它不应该发生。但是，这很可能是由于错误而发生的，因此请使用随机值（0xdeadbeef）
 //请进行设置，以便您能够注意到。
     cpuvar->arch.sp_top = 0xdeadbeef;
+    cpuvar->arch.frame = 0xdeadbeef;
     write_stvec((uint32_t) riscv32_trap_handler);
 
     //配置 M 模式中断处理程序和各种设置。顾名思义，只有定时器中断是M模式。
@@ -163,11 +163,6 @@ void arch_init_percpu(void) {
     //该任务应该已经初始化
     ASSERT(CURRENT_TASK == IDLE_TASK);
 
-    //由于在第一次上下文切换之前不会发生中断，因此此处设置的值是
-//没用过。但是，由于内核错误可能会出现异常，因此以防万一
-//放在这里。
-    CPUVAR->arch.sp_top = IDLE_TASK->arch.sp_top;
-
     //使用户页面可以从 S 模式（内核）访问。
     write_sstatus(read_sstatus() | SSTATUS_SUM);
 
@@ -178,10 +173,7 @@ void arch_init_percpu(void) {
     //将 CPU 标记为已启动。
     riscv32_mp_init_percpu();
 
-    //设置定时器中断。
-    uint32_t last_mtime = *MTIME;
-    *MTIMECMP = last_mtime + CPUVAR->arch.interval;
-    CPUVAR->arch.last_mtime = last_mtime;
+    //定时器中断由空闲任务根据需要设置（arch_timer_set函数）。
 
     if (CPUVAR->id == 0) {
         hart0_ready = true;
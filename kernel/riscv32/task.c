@@ -1,76 +1,152 @@
 #include "asm.h"
 #include "debug.h"
+#include "handler.h"
 #include "mp.h"
 #include "switch.h"
+#include "trap.h"
 #include <kernel/arch.h>
 #include <kernel/hinavm.h>
 #include <kernel/memory.h>
 #include <kernel/printk.h>
+#include <kernel/syscall.h>
 #include <kernel/task.h>
+#include <kernel/timer.h>
+#include <libs/common/string.h>
 
-//第一次上下文切换到用户任务时调用的函数
-__noreturn void riscv32_user_entry(uint32_t ip) {
+//未使用的内核栈的列表。每个栈的底部（金丝雀的下一个字）保存下一个元素的地址。
+//内核栈不属于任务，而是由CPU使用：任务只在保留内核栈而阻塞（或被抢占）期间持有
+//内核栈，以续体阻塞时放弃它。
+static vaddr_t free_stacks = 0;
+
+//分配内核栈。返回栈的底部，失败时返回 0。
+static vaddr_t stack_alloc(void) {
+    if (free_stacks) {
+        vaddr_t stack = free_stacks;
+        free_stacks = *((vaddr_t *) (stack + sizeof(uint32_t)));
+        return stack;
+    }
+
+    //始终使用堆栈金丝雀地址，指定 PM_ALLOC_ALIGNED 标志，以便可以通过
+    //stack_bottom 函数计算。分配堆栈大小的倍数的地址。
+    paddr_t paddr = pm_alloc(KERNEL_STACK_SIZE, NULL,
+                             PM_ALLOC_ALIGNED | PM_ALLOC_UNINITIALIZED);
+    if (!paddr) {
+        return 0;
+    }
+
+    vaddr_t stack = arch_paddr_to_vaddr(paddr);
+    stack_set_canary(stack);
+    return stack;
+}
+
+//将内核栈放回未使用的列表。
+static void stack_free(vaddr_t stack) {
+    *((vaddr_t *) (stack + sizeof(uint32_t))) = free_stacks;
+    free_stacks = stack;
+}
+
+//准备内核栈，使 riscv32_task_switch 函数切换到它时从 entry(arg) 开始执行。返回
+//应该恢复的栈指针。
+static uint32_t prepare_stack(vaddr_t stack, vaddr_t entry, void *arg) {
+    //请注意，堆栈从地址开始向下增长。
+    uint32_t *sp = (uint32_t *) (stack + KERNEL_STACK_SIZE);
+
+    //Riscv32内核入口trampoline函数中弹出的值
+    *--sp = (uint32_t) entry;//任务执行起始地址
+    *--sp = (uint32_t) arg;//传递给 a0 寄存器的值（第一个参数）
+
+    //Riscv32任务切换函数中恢复执行上下文
+    *--sp = 0;//s11
+    *--sp = 0;//s10
+    *--sp = 0;//s9
+    *--sp = 0;//s8
+    *--sp = 0;//s7
+    *--sp = 0;//s6
+    *--sp = 0;//s5
+    *--sp = 0;//s4
+    *--sp = 0;//s3
+    *--sp = 0;//s2
+    *--sp = 0;//s1
+    *--sp = 0;//s0
+    *--sp = (uint32_t) riscv32_kernel_entry_trampoline;//拉
+    return (uint32_t) sp;
+}
+
+//从陷阱帧恢复正在运行的任务的寄存器并返回用户模式。
+__noreturn void arch_return_to_user(void) {
+    struct riscv32_trap_frame *frame = &CURRENT_TASK->arch.frame;
+    timer_reprogram();
     mp_unlock();//释放内核锁进入用户态
-    write_sepc(ip);//设置用户任务的执行起始地址
+    riscv32_trap_return(frame);
+}
+
+//将系统调用的返回值设置到 a0 寄存器并返回用户模式。fm 不为 NULL 时，还将寄存器IPC
+//收到的消息设置到寄存器。用于以续体恢复的系统调用。
+__noreturn void arch_syscall_return(long ret, const struct fast_message *fm) {
+    struct riscv32_trap_frame *frame = &CURRENT_TASK->arch.frame;
+    frame->a0 = ret;
+    if (fm) {
+        riscv32_set_fast_message(frame, fm);
+    }
+
+    arch_return_to_user();
+}
+
+//从头重新执行系统调用（ecall指令）。用于以续体恢复、可以重新执行的系统调用。
+__noreturn void arch_syscall_restart(void) {
+    CURRENT_TASK->arch.frame.pc -= 4;
+    arch_return_to_user();
+}
 
+//用户任务第一次执行时的续体。陷阱帧中已经设置了执行起始地址和 sp、a0 寄存器的
+//初始值，其他寄存器为零，以避免泄漏内核信息。
+__noreturn static void user_entry(void) {
     //设置 Sret 指令应恢复的状态
     uint32_t sstatus = read_sstatus();
-    sstatus &= ~SSTATUS_SPP;  //
+    sstatus &= ~SSTATUS_SPP;
     sstatus |= SSTATUS_SPIE;
-    write_sstatus(sstatus);
-
-    //进入用户模式之前清除寄存器以避免泄漏内核信息
-    __asm__ __volatile__(
-        "mv x1, zero\n\t"
-        "mv x2, zero\n\t"
-        "mv x3, zero\n\t"
-        "mv x4, zero\n\t"
-        "mv x5, zero\n\t"
-        "mv x6, zero\n\t"
-        "mv x7, zero\n\t"
-        "mv x8, zero\n\t"
-        "mv x10, zero\n\t"
-        "mv x11, zero\n\t"
-        "mv x12, zero\n\t"
-        "mv x13, zero\n\t"
-        "mv x14, zero\n\t"
-        "mv x15, zero\n\t"
-        "mv x16, zero\n\t"
-        "mv x17, zero\n\t"
-        "mv x18, zero\n\t"
-        "mv x19, zero\n\t"
-        "mv x20, zero\n\t"
-        "mv x21, zero\n\t"
-        "mv x22, zero\n\t"
-        "mv x23, zero\n\t"
-        "mv x24, zero\n\t"
-        "mv x25, zero\n\t"
-        "mv x26, zero\n\t"
-        "mv x27, zero\n\t"
-        "mv x28, zero\n\t"
-        "mv x29, zero\n\t"
-        "mv x30, zero\n\t"
-        "mv x31, zero\n\t"
-        "sret");
-
-    //该函数永远不会返回。每当您从用户任务返回内核模式时
-//riscv32_trap_handler 是入口点。
-    UNREACHABLE();
+    CURRENT_TASK->arch.frame.sstatus = sstatus;
+    arch_return_to_user();
+}
+
+//在新的内核栈上执行续体。
+__noreturn static void continuation_entry(void) {
+    struct task *current = CURRENT_TASK;
+    continuation_t continuation = current->continuation;
+    current->continuation = NULL;
+    continuation();
 }
 
 //切换到下一个任务（下一个）。 prev 指定当前正在运行的任务。
 void arch_task_switch(struct task *prev, struct task *next) {
-    //切换中断处理程序中使用的内核堆栈。在系统调用处理程序内部
-//由于每个任务都可能进入休眠状态，因此需要一个专门的任务
-//需要内核堆栈。
-    CPUVAR->arch.sp_top = next->arch.sp_top;
+    //以续体阻塞的任务在新的内核栈上从续体开始执行。
+    if (next->continuation) {
+        next->arch.stack = stack_alloc();
+        if (!next->arch.stack) {
+            PANIC("failed to allocate a kernel stack");
+        }
+
+        next->arch.sp =
+            prepare_stack(next->arch.stack, (vaddr_t) continuation_entry, NULL);
+    }
+
+    //以续体阻塞的任务放弃内核栈。虽然直到切换之前仍在使用它，但在释放内核锁
+    //之前其他CPU不会分配它。
+    if (prev->continuation && prev->arch.stack) {
+        stack_free(prev->arch.stack);
+        prev->arch.stack = 0;
+    }
+
+    //切换中断处理程序中使用的内核栈和保存用户模式寄存器的陷阱帧。
+    CPUVAR->arch.sp_top = next->arch.stack + KERNEL_STACK_SIZE;
+    CPUVAR->arch.frame = (uint32_t) &next->arch.frame;
 
     //切换页表并刷新 TLB。在写入 satp 寄存器之前一次
 //之所以执行sfence.vma指令是因为在此之前对页表所做的更改是
 //以确保完成。
 //（RISC-V指令集手册第二卷，版本1.10，第58页）
     asm_sfence_vma();
-    write_satp(SATP_MODE_SV32 | next->vm.table >> SATP_PPN_SHIFT);
+    write_satp(SATP_MODE_SV32 | next->process->vm.table >> SATP_PPN_SHIFT);
     asm_sfence_vma();
 
     //切换寄存器并将执行移至下一个任务（下一个）。此任务（上一个）是
@@ -80,59 +156,35 @@ void arch_task_switch(struct task *prev, struct task *next) {
 }
 
 //初始化任务
-error_t arch_task_init(struct task *task, uaddr_t ip, vaddr_t kernel_entry,
-                       void *arg) {
-    //分配内核堆栈。始终使用堆栈金丝雀地址
-//指定 PM_ALLOC_ALIGNED 标志，以便可以通过 stack_bottom 函数计算。
-//分配堆栈大小的倍数的地址。
-    paddr_t sp_bottom = pm_alloc(KERNEL_STACK_SIZE, NULL,
-                                 PM_ALLOC_ALIGNED | PM_ALLOC_UNINITIALIZED);
-    if (!sp_bottom) {
-        return ERR_NO_MEMORY;
-    }
-
-    //准备内核堆栈。请注意，堆栈从地址开始向下增长。
-    uint32_t sp_top = sp_bottom + KERNEL_STACK_SIZE;
-    uint32_t *sp = (uint32_t *) arch_paddr_to_vaddr(sp_top);
-
-    uint32_t entry;
+error_t arch_task_init(struct task *task, uaddr_t ip, uaddr_t sp,
+                       vaddr_t kernel_entry, void *arg) {
     if (kernel_entry) {
-        //Riscv32内核入口trampoline函数中弹出的值
-        *--sp = (uint32_t) kernel_entry;//任务执行起始地址
-        *--sp = (uint32_t) arg;//传递给 a0 寄存器的值（第一个参数）
-        entry = (uint32_t) riscv32_kernel_entry_trampoline;
-    } else {
-        //Riscv32用户入口trampoline函数中弹出的值
-        *--sp = ip;//任务执行起始地址
-        entry = (uint32_t) riscv32_user_entry_trampoline;
-    }
-
-    //Riscv32任务切换函数中恢复执行上下文
-    *--sp = 0;//s11
-    *--sp = 0;//s10
-    *--sp = 0;//s9
-    *--sp = 0;//s8
-    *--sp = 0;//s7
-    *--sp = 0;//s6
-    *--sp = 0;//s5
-    *--sp = 0;//s4
-    *--sp = 0;//s3
-    *--sp = 0;//s2
-    *--sp = 0;//s1
-    *--sp = 0;//s0
-    *--sp = entry;//拉
+        //内核任务（HinaVM）在自己的内核栈上执行，始终持有它。
+        vaddr_t stack = stack_alloc();
+        if (!stack) {
+            return ERR_NO_MEMORY;
+        }
 
-    //填充任务管理结构
-    task->arch.sp = (uint32_t) sp;
-    task->arch.sp_bottom = sp_bottom;
-    task->arch.sp_top = (uint32_t) sp_top;
+        task->arch.stack = stack;
+        task->arch.sp = prepare_stack(stack, kernel_entry, arg);
+        return OK;
+    }
 
-    //将堆栈金丝雀设置为内核堆栈
-    stack_set_canary(sp_bottom);
+    //用户任务不需要预先分配内核栈：第一次执行时作为续体在新的内核栈上开始，
+    //从陷阱帧进入用户模式。
+    memset(&task->arch.frame, 0, sizeof(task->arch.frame));
+    task->arch.frame.pc = ip;
+    task->arch.frame.sp = sp;
+    task->arch.frame.a0 = (uint32_t) arg;
+    task->arch.stack = 0;
+    task->continuation = user_entry;
     return OK;
 }
 
 //放弃任务
 void arch_task_destroy(struct task *task) {
-    pm_free(task->arch.sp_bottom, KERNEL_STACK_SIZE);
+    if (task->arch.stack) {
+        stack_free(task->arch.stack);
+        task->arch.stack = 0;
+    }
 }
@@ -0,0 +1,56 @@
+// CLINTのタイマーを使ったワンショットタイマー
+//
+// 一定周期のタイマー割り込みは使わず、カーネルが次に処理すべき時刻 (タイムアウトやタイム
+// スライスの終わり) だけをmtimecmpレジスタに設定する。何もすることがないCPUにはタイマー
+// 割り込みが来ない。
+#include "asm.h"
+#include <kernel/arch.h>
+#include <libs/common/print.h>
+
+// 1tickあたりのmtimeレジスタの増分
+#define MTIME_PER_TICK (MTIME_PER_1MS / (TICK_HZ / 1000))
+// 1マイクロ秒あたりのmtimeレジスタの増分
+#define MTIME_PER_US (MTIME_PER_1MS / 1000)
+// 一度に眠る最大の時間 (tick)。経過時間をmtimeの32ビットの差分から数えているので、差分が
+// オーバーフローする前に必ず一度は起きるようにする。
+#define TIMER_MAX_SLEEP (60 * TICK_HZ)
+
+static uint64_t uptime_mtime;  // uptime_ticksに反映済みのmtimeの値
+static unsigned uptime_ticks;  // 起動してからの経過時間 (tick)
+
+// 起動してからの経過時間をtick単位で返す。
+unsigned arch_uptime(void) {
+    uint32_t diff = (uint32_t) (*MTIME - uptime_mtime);
+    unsigned ticks = diff / MTIME_PER_TICK;
+    uptime_ticks += ticks;
+    uptime_mtime += ticks * MTIME_PER_TICK;
+    return uptime_ticks;
+}
+
+// tickよりも細かい時間を測るための時計 (mtimeレジスタの値) を返す。
+uint64_t arch_clock(void) {
+    return *MTIME;
+}
+
+// arch_clock関数が返した時刻*sinceからの経過時間をマイクロ秒単位で返し、*sinceをその分
+// だけ進める。1マイクロ秒未満の端数は次回に持ち越される。
+unsigned arch_clock_elapsed_us(uint64_t *since) {
+    uint32_t diff = (uint32_t) (*MTIME - *since);
+    unsigned us = diff / MTIME_PER_US;
+    *since += us * MTIME_PER_US;
+    return us;
+}
+
+// 経過時間がdeadline (tick) になったときに、このCPUにタイマー割り込みを発生させる。
+// deadlineが0の場合は、TIMER_MAX_SLEEPが経つまでタイマー割り込みを発生させない。
+void arch_timer_set(unsigned deadline) {
+    unsigned now = arch_uptime();
+    unsigned ticks = TIMER_MAX_SLEEP;
+    if (deadline) {
+        // すでに過ぎている場合はすぐに割り込みを発生させる
+        int remaining = (int) (deadline - now);
+        ticks = (remaining > 0) ? MIN((unsigned) remaining, TIMER_MAX_SLEEP) : 0;
+    }
+
+    *MTIMECMP = uptime_mtime + ticks * MTIME_PER_TICK;
+}
@@ -11,16 +11,47 @@
 #include <kernel/printk.h>
 #include <kernel/syscall.h>
 #include <kernel/task.h>
+#include <kernel/timer.h>
+
+//将寄存器IPC收到的消息设置到寄存器：a1为发送方，a3为消息类型，a4、a6、a7为消息数据。
+void riscv32_set_fast_message(struct riscv32_trap_frame *frame,
+                              const struct fast_message *fm) {
+    frame->a1 = fm->src;
+    frame->a3 = fm->type;
+    frame->a4 = fm->data[0];
+    frame->a6 = fm->data[1];
+    frame->a7 = fm->data[2];
+}
 
 //系统调用
 static void handle_syscall_trap(struct riscv32_trap_frame *frame) {
+    //更新要恢复的程序计数器的值，返回到调用系统调用的指令（ecall指令）的下一个
+    //指令。以续体恢复的系统调用不经过这里返回，因此在调用处理程序之前更新。
+    frame->pc += 4;
+
+    if (frame->a5 == SYS_IPC_FAST) {
+        //寄存器IPC：a3为消息类型，a4、a6、a7为消息数据。接收到的消息写回相同的
+        //寄存器，发送方写入a1。
+        struct fast_message fm;
+        fm.type = frame->a3;
+        fm.data[0] = frame->a4;
+        fm.data[1] = frame->a6;
+        fm.data[2] = frame->a7;
+        unsigned flags = frame->a2;
+        error_t err = sys_ipc_fast(frame->a0, frame->a1, flags, &fm);
+        frame->a0 = err;
+
+        //只在收到消息时写回寄存器。否则 fm 的一部分（fm.src）没有初始化，会泄漏
+        //内核栈的内容。
+        if (err == OK && (flags & IPC_RECV)) {
+            riscv32_set_fast_message(frame, &fm);
+        }
+        return;
+    }
+
     //调用系统调用处理程序并将返回值设置到a0寄存器
     frame->a0 = handle_syscall(frame->a0, frame->a1, frame->a2, frame->a3,
                                frame->a4, frame->a5);
-
-    //更新要恢复的程序计数器的值并更新调用系统调用的指令（ecall指令）。
-//返回到下一个命令
-    frame->pc += 4;
 }
 
 //软件中断：来自riscv32_timer_handler的进程间中断和定时器中断。
@@ -46,13 +77,9 @@ static void handle_soft_interrupt_trap(void) {
         }
     }
 
-    //如果定时器正在运行，则调用定时器中断处理程序
-    unsigned now = *MTIME;
-    unsigned ticks = MTIME_TO_TICKS(now - CPUVAR->arch.last_mtime);
-    CPUVAR->arch.last_mtime = now;
-    if (ticks > 0) {
-        handle_timer_interrupt(ticks);
-    }
+    //调用定时器中断处理程序。定时器中断只在需要处理事件时发生，因此即使经过的时间
+    //不满一个tick也要调用，让它处理超时和任务切换。
+    handle_timer_interrupt();
 }
 
 //硬件中断
@@ -112,7 +139,7 @@ static void handle_page_fault_trap(struct riscv32_trap_frame *frame) {
 //在这种情况下我们已经有一个内核锁，所以我们在这里获取锁
 //（调用mp_lock函数）不需要。
         reason |= PAGE_FAULT_USER;
-        handle_page_fault(vaddr, sepc, reason);
+        handle_page_fault(vaddr, sepc, reason, false);
     } else {
         //内核模式中的页面错误被视为致命错误。
         if ((reason & PAGE_FAULT_USER) == 0) {
@@ -121,14 +148,29 @@ static void handle_page_fault_trap(struct riscv32_trap_frame *frame) {
         }
 
         //用户模式下的页面错误调用寻呼任务。寻呼机任务图
-//请注意，我会阻止你，直到你这样做为止。
+//请注意，我会阻止你，直到你这样做为止。等待期间不保留内核栈（续体）。
         mp_lock();
-        handle_page_fault(vaddr, sepc, reason);
+        handle_page_fault(vaddr, sepc, reason, true);
+        timer_reprogram();
         mp_unlock();
     }
 }
 
-//中断/异常处理程序：引导过程完成后，该函数是内核模式的入口点。
+//系统调用处理程序：用户模式的ecall指令不经过 riscv32_handle_trap 函数，由陷阱处理
+//程序的快速路径 (riscv32_syscall_entry) 直接调用该函数。
+void riscv32_handle_syscall(struct riscv32_trap_frame *frame) {
+    stack_check();//检查堆栈溢出
+
+    mp_lock();
+    handle_syscall_trap(frame);
+    timer_reprogram();
+    mp_unlock();
+
+    stack_check();//检查堆栈溢出
+}
+
+//中断/异常处理程序：引导过程完成后，该函数是内核模式的入口点。系统调用由
+//riscv32_handle_syscall 函数处理。
 void riscv32_handle_trap(struct riscv32_trap_frame *frame) {
     stack_check();//检查堆栈溢出
 
@@ -138,22 +180,18 @@ void riscv32_handle_trap(struct riscv32_trap_frame *frame) {
 
     uint32_t scause = read_scause();//获取中断原因
     switch (scause) {
-        //系统调用
-        case SCAUSE_ENV_CALL:
-            mp_lock();
-            handle_syscall_trap(frame);
-            mp_unlock();
-            break;
         //软件中断
         case SCAUSE_S_SOFT_INTR:
             mp_lock();
             handle_soft_interrupt_trap();
+            timer_reprogram();
             mp_unlock();
             break;
         //外部中断
         case SCAUSE_S_EXT_INTR:
             mp_lock();
             handle_external_interrupt_trap();
+            timer_reprogram();
             mp_unlock();
             break;
         //页面错误
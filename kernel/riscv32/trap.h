@@ -38,4 +38,8 @@ struct riscv32_trap_frame {
     uint32_t s11;      // オフセット: 4 * 32
 } __packed;
 
+struct fast_message;
+void riscv32_set_fast_message(struct riscv32_trap_frame *frame,
+                              const struct fast_message *fm);
+void riscv32_handle_syscall(struct riscv32_trap_frame *frame);
 void riscv32_handle_trap(struct riscv32_trap_frame *frame);
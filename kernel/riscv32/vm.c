@@ -115,6 +115,21 @@ error_t arch_vm_unmap(struct arch_vm *vm, vaddr_t vaddr) {
     return OK;
 }
 
+//返回映射到用户空间虚拟地址的物理地址，并在attrs中返回页面属性（PAGE_*宏）。
+//如果未映射则返回0。
+paddr_t arch_vm_lookup(struct arch_vm *vm, vaddr_t vaddr, unsigned *attrs) {
+    pte_t *pte;
+    error_t err = walk(vm->table, vaddr, false, &pte);
+    if (err != OK || (*pte & (PTE_V | PTE_U)) != (PTE_V | PTE_U)) {
+        return 0;
+    }
+
+    *attrs = ((*pte & PTE_R) ? PAGE_READABLE : 0)
+             | ((*pte & PTE_W) ? PAGE_WRITABLE : 0)
+             | ((*pte & PTE_X) ? PAGE_EXECUTABLE : 0) | PAGE_USER;
+    return PTE_PADDR(*pte);
+}
+
 //返回虚拟地址是否映射到页表。
 bool riscv32_is_mapped(uint32_t satp, vaddr_t vaddr) {
     satp = (satp & SATP_PPN_MASK) << SATP_PPN_SHIFT;
@@ -6,6 +6,7 @@
 #include "memory.h"
 #include "printk.h"
 #include "task.h"
+#include "timer.h"
 #include <libs/common/string.h>
 
 //从用户空间进行内存复制。与普通memcpy不同的是，如果复制过程中出现页面错误
@@ -109,7 +110,7 @@ static task_t sys_hinavm(__user const char *name, __user hinavm_inst_t *insts,
 //删除任务。
 static error_t sys_task_destroy(task_t tid) {
     struct task *task = task_find(tid);
-    if (!task || task == CURRENT_TASK) {
+    if (!task || task == CURRENT_TASK || task == CURRENT_TASK->process) {
         return ERR_INVALID_TASK;
     }
 
@@ -121,6 +122,124 @@ __noreturn static void sys_task_exit(void) {
     task_exit(EXP_GRACE_EXIT);
 }
 
+//创建任务 tid 的线程。线程从 ip 开始执行，sp 和 arg 是 sp 和 a0 寄存器的初始值。只有
+//该任务的寻呼任务可以创建线程，以便寻呼任务知道线程属于哪个任务。
+static task_t sys_thread_create(task_t tid, uaddr_t ip, uaddr_t sp,
+                                uaddr_t arg) {
+    struct task *process = task_find(tid);
+    if (!process || process->process != process) {
+        return ERR_INVALID_TASK;
+    }
+
+    if (process->pager != CURRENT_TASK->process) {
+        return ERR_NOT_ALLOWED;
+    }
+
+    if (!arch_is_mappable_uaddr(ip) || !arch_is_mappable_uaddr(sp - 1)) {
+        return ERR_INVALID_UADDR;
+    }
+
+    return thread_create(process, ip, sp, arg);
+}
+
+//终止正在运行的线程。寻呼任务收到 EXP_GRACE_EXIT 异常后删除该线程。在主线程中调用
+//时与 task_exit 系统调用相同，结束整个任务。
+__noreturn static void sys_thread_exit(void) {
+    task_exit(EXP_GRACE_EXIT);
+}
+
+//更改任务的优先级。寻呼任务可以任意更改它的任务的优先级。任务自己只能降低自己的
+//优先级，否则任何任务都可以提高到最高优先级而让其他任务（包括寻呼任务）无法执行。
+//没有寻呼任务的第一个任务（虚拟机服务器）可以任意更改自己的优先级。
+static error_t sys_task_set_priority(task_t tid, int priority) {
+    struct task *task = task_find(tid);
+    if (!task) {
+        return ERR_INVALID_TASK;
+    }
+
+    if (priority < 0 || priority >= TASK_PRIORITY_MAX) {
+        return ERR_INVALID_ARG;
+    }
+
+    if (task->pager != CURRENT_TASK) {
+        if (task != CURRENT_TASK) {
+            return ERR_NOT_ALLOWED;
+        }
+
+        if (task->pager && priority < task->base_priority) {
+            return ERR_NOT_ALLOWED;
+        }
+    }
+
+    task_set_priority(task, priority);
+    return OK;
+}
+
+//更改任务的CPU亲和性。affinity 是可以执行该任务的CPU的位图。只能更改自己或者自己是
+//寻呼任务的任务的CPU亲和性。
+static error_t sys_task_set_affinity(task_t tid, unsigned affinity) {
+    struct task *task = task_find(tid);
+    if (!task) {
+        return ERR_INVALID_TASK;
+    }
+
+    if (task != CURRENT_TASK && task->pager != CURRENT_TASK) {
+        return ERR_NOT_ALLOWED;
+    }
+
+    if ((affinity & TASK_AFFINITY_ALL) == 0) {
+        return ERR_INVALID_ARG;
+    }
+
+    task_set_affinity(task, affinity & TASK_AFFINITY_ALL);
+    return OK;
+}
+
+//为任务预留CPU时间：每 period 毫秒中的 budget 毫秒以高优先级执行。budget 为零时取消
+//预留。只有寻呼任务可以更改它的任务的设置：预留CPU时间以最高优先级执行，如果任务
+//可以给自己预留，就可以让其他所有任务无法执行。
+static error_t sys_task_set_reservation(task_t tid, int budget, int period) {
+    struct task *task = task_find(tid);
+    if (!task) {
+        return ERR_INVALID_TASK;
+    }
+
+    if (task->pager != CURRENT_TASK) {
+        return ERR_NOT_ALLOWED;
+    }
+
+    if (budget < 0 || period <= 0 || budget > period
+        || period > TASK_RESERVATION_PERIOD_MAX / (TICK_HZ / 1000)) {
+        return ERR_INVALID_ARG;
+    }
+
+    task_set_reservation(task, budget * (TICK_HZ / 1000),
+                         period * (TICK_HZ / 1000));
+    return OK;
+}
+
+//获取任务的调度统计信息。获取任务表的索引不小于 TASK_INDEX(tid) 的第一个任务的统计
+//信息并返回其任务ID，用于枚举所有任务。没有这样的任务时返回 ERR_NOT_FOUND。
+static task_t sys_task_stats(task_t tid, __user struct task_stats *buf) {
+    if (tid <= 0) {
+        return ERR_INVALID_ARG;
+    }
+
+    for (unsigned index = TASK_INDEX(tid); index <= NUM_TASKS_MAX; index++) {
+        struct task *task = task_find_by_index(index);
+        if (!task) {
+            continue;
+        }
+
+        struct task_stats stats;
+        task_get_stats(task, &stats);
+        error_t err = memcpy_to_user(buf, &stats, sizeof(stats));
+        return (err == OK) ? task->tid : err;
+    }
+
+    return ERR_NOT_FOUND;
+}
+
 //获取正在运行的任务的任务ID。
 static task_t sys_task_self(void) {
     return CURRENT_TASK->tid;
@@ -155,6 +274,25 @@ static pfn_t sys_pm_alloc(task_t tid, size_t size, unsigned flags) {
     return PADDR2PFN(paddr);
 }
 
+//释放 pm_alloc 系统调用分配的物理页。只能释放已经取消了所有映射的页面。
+static error_t sys_pm_free(task_t tid, pfn_t pfn, size_t size) {
+    struct task *task = task_find(tid);
+    if (!task) {
+        return ERR_INVALID_TASK;
+    }
+
+    if (task != CURRENT_TASK && task->pager != CURRENT_TASK) {
+        return ERR_INVALID_TASK;
+    }
+
+    paddr_t paddr = PFN2PADDR(pfn);
+    if (!size || !IS_ALIGNED(size, PAGE_SIZE) || paddr + size < paddr) {
+        return ERR_INVALID_ARG;
+    }
+
+    return pm_free_unmapped(task, paddr, size);
+}
+
 //将页面映射到虚拟地址空间。
 static paddr_t sys_vm_map(task_t tid, uaddr_t uaddr, paddr_t paddr,
                           unsigned attrs) {
@@ -204,29 +342,236 @@ static paddr_t sys_vm_unmap(task_t tid, uaddr_t uaddr) {
     return vm_unmap(task, uaddr);
 }
 
+//设置接收out-of-line缓冲区的窗口。之后收到的消息中附带的页面会被移动到这里。
+//如果size为零，则不再接收out-of-line缓冲区。
+static error_t sys_ool_window(uaddr_t base, size_t size) {
+    //检查是否与页面边界对齐
+    if (!IS_ALIGNED(base, PAGE_SIZE) || !IS_ALIGNED(size, PAGE_SIZE)) {
+        return ERR_INVALID_ARG;
+    }
+
+    //检查整个窗口是否都是可映射的地址
+    if (size > 0
+        && (base + size < base || !arch_is_mappable_uaddr(base)
+            || !arch_is_mappable_uaddr(base + size - 1))) {
+        return ERR_INVALID_UADDR;
+    }
+
+    CURRENT_TASK->ool_window = base;
+    CURRENT_TASK->ool_window_size = size;
+    return OK;
+}
+
+//ipc系统调用结束时取消超时。
+static void ipc_finish(void) {
+    struct task *current = CURRENT_TASK;
+    timer_cancel(&current->ipc_timer);
+    current->ipc_expired = false;
+}
+
+//以续体恢复的ipc系统调用的结束处理。
+__noreturn static void sys_ipc_done(error_t err) {
+    ipc_finish();
+    arch_syscall_return(err, NULL);
+}
+
 //发送和接收消息。
+//
+//如果 timeout 不为零，则在 timeout 毫秒后中断发送和接收的等待，并返回 ERR_TIMEOUT。
+//需要等待时不保留内核栈 (IPC_CONTINUE)，由 sys_ipc_done 函数返回用户模式。
 static error_t sys_ipc(task_t dst, task_t src, __user struct message *m,
-                       unsigned flags) {
+                       unsigned flags, unsigned timeout) {
     //检查不允许的标志
-    if ((flags & ~(IPC_SEND | IPC_RECV | IPC_NOBLOCK)) != 0) {
+    if ((flags & ~(IPC_SEND | IPC_RECV | IPC_NOBLOCK | IPC_REPLY | IPC_ASYNC))
+        != 0) {
         return ERR_INVALID_ARG;
     }
 
     //检查它是否是有效的任务ID
-    if (src < 0 || src > NUM_TASKS_MAX) {
+    if (src < 0) {
         return ERR_INVALID_ARG;
     }
 
     //如果包含发送处理，则获取发送目的地任务
     struct task *dst_task = NULL;
     if (flags & IPC_SEND) {
+        dst_task = task_find(dst);
+        if (!dst_task) {
+            if ((flags & IPC_REPLY_RECV) != IPC_REPLY_RECV) {
+                return ERR_INVALID_TASK;
+            }
+
+            //回复目标已经退出。丢弃回复，仅进行接收处理。
+            flags &= ~(IPC_SEND | IPC_REPLY);
+        }
+    }
+
+    struct task *current = CURRENT_TASK;
+    current->ipc_expired = false;
+    if (timeout) {
+        timer_start(&current->ipc_timer, timeout);
+    }
+
+    current->cont_done = sys_ipc_done;
+    error_t err = ipc(dst_task, src, m, flags | IPC_CONTINUE);
+    ipc_finish();
+    return err;
+}
+
+//登记消息缓冲区。之后在该缓冲区中接收消息时，如果发送方的消息可以不阻塞地读取，
+//则内核将其直接从发送方复制到该缓冲区（单次复制）。uaddr 为 0 时取消登记。
+static error_t sys_ipc_buffer(uaddr_t uaddr) {
+    struct task *current = CURRENT_TASK;
+    if (uaddr && (!IS_ALIGNED(uaddr, sizeof(uint32_t))
+                  || uaddr % PAGE_SIZE + sizeof(struct message) > PAGE_SIZE)) {
+        //缓冲区必须在一个页面内
+        return ERR_INVALID_ARG;
+    }
+
+    paddr_t paddr = 0;
+    if (uaddr) {
+        //让页面以可写方式映射，然后固定它
+        uint8_t tmp;
+        error_t err = memcpy_from_user(&tmp, (__user void *) uaddr, 1);
+        if (err == OK) {
+            err = memcpy_to_user((__user void *) uaddr, &tmp, 1);
+        }
+
+        if (err != OK) {
+            return err;
+        }
+
+        paddr = vm_pin_page(current, ALIGN_DOWN(uaddr, PAGE_SIZE));
+        if (!paddr) {
+            return ERR_NOT_ALLOWED;
+        }
+    }
+
+    if (current->ipc_buffer) {
+        pm_free(current->ipc_buffer_paddr, PAGE_SIZE);
+    }
+
+    current->ipc_buffer_uaddr = uaddr;
+    current->ipc_buffer_paddr = paddr;
+    current->ipc_buffer =
+        uaddr ? (struct message *) (arch_paddr_to_vaddr(paddr)
+                                    + uaddr % PAGE_SIZE)
+              : NULL;
+    return OK;
+}
+
+//寄存器IPC的结果。收到的消息在 current->m 中，将其设置到 fm。
+static error_t fast_result(error_t err, unsigned flags,
+                           struct fast_message *fm) {
+    if (err != OK || !(flags & IPC_RECV)) {
+        return err;
+    }
+
+    struct message *m = &CURRENT_TASK->m;
+    if (!msg_fits_fast(m)) {
+        WARN("%s: dropped a too large message (%s) from #%d for fast IPC",
+             CURRENT_TASK->name, msgtype2str(m->type), m->src);
+        return ERR_TOO_LARGE;
+    }
+
+    fm->type = m->type;
+    fm->src = m->src;
+    memcpy(fm->data, m->data, sizeof(fm->data));
+    return OK;
+}
+
+//以续体恢复的寄存器IPC的结束处理。
+__noreturn static void sys_ipc_fast_done(error_t err) {
+    struct fast_message fm;
+    err = fast_result(err, CURRENT_TASK->cont_flags, &fm);
+    bool received = err == OK && (CURRENT_TASK->cont_flags & IPC_RECV);
+    arch_syscall_return(err, received ? &fm : NULL);
+}
+
+//寄存器IPC。与ipc系统调用相同，但消息的类型和数据通过寄存器 (fm) 传递，不访问
+//用户空间的内存。只能发送和接收足够小的消息，收到大的消息时丢弃它并返回
+//ERR_TOO_LARGE。由各架构的系统调用处理程序调用。
+//
+//消息缓冲区使用 current->m，这样以续体恢复时也不需要内核栈上的变量。
+error_t sys_ipc_fast(task_t dst, task_t src, unsigned flags,
+                     struct fast_message *fm) {
+    if ((flags & ~(IPC_SEND | IPC_RECV | IPC_NOBLOCK | IPC_REPLY)) != 0) {
+        return ERR_INVALID_ARG;
+    }
+
+    if (src < 0) {
+        return ERR_INVALID_ARG;
+    }
+
+    struct task *current = CURRENT_TASK;
+    struct message *m = &current->m;
+    struct task *dst_task = NULL;
+    if (flags & IPC_SEND) {
+        m->type = fm->type;
+        memcpy(m->data, fm->data, sizeof(fm->data));
+        if (!msg_fits_fast(m)) {
+            return ERR_TOO_LARGE;
+        }
+
         dst_task = task_find(dst);
         if (!dst_task) {
             return ERR_INVALID_TASK;
         }
     }
 
-    return ipc(dst_task, src, m, flags);
+    current->cont_done = sys_ipc_fast_done;
+    error_t err = ipc(dst_task, src, (__user struct message *) m,
+                      flags | IPC_FAST | IPC_CONTINUE);
+    return fast_result(err, flags, fm);
+}
+
+//批量发送多个消息。每个消息都不阻塞 (IPC_NOBLOCK)，结果写入各条目的 err。
+static error_t sys_ipc_batch(__user struct ipc_batch_entry *entries,
+                             size_t num) {
+    if (num > IPC_BATCH_MAX) {
+        return ERR_TOO_LARGE;
+    }
+
+    struct ipc_batch_entry batch[IPC_BATCH_MAX];
+    error_t err = memcpy_from_user(batch, entries, sizeof(*batch) * num);
+    if (err != OK) {
+        return err;
+    }
+
+    for (size_t i = 0; i < num; i++) {
+        struct ipc_batch_entry *e = &batch[i];
+        if ((e->flags & ~IPC_ASYNC) != 0) {
+            e->err = ERR_INVALID_ARG;
+            continue;
+        }
+
+        struct task *dst_task = task_find(e->dst);
+        if (!dst_task) {
+            e->err = ERR_INVALID_TASK;
+            continue;
+        }
+
+        e->err = ipc(dst_task, 0, (__user struct message *) e->m,
+                     IPC_SEND | IPC_NOBLOCK | e->flags);
+    }
+
+    return memcpy_to_user(entries, batch, sizeof(*batch) * num);
+}
+
+//将 worker 任务作为 leader 任务的工作任务加入服务。只有两者的寻呼任务可以调用。
+static error_t sys_service_join(task_t leader, task_t worker) {
+    struct task *leader_task = task_find(leader);
+    struct task *worker_task = task_find(worker);
+    if (!leader_task || !worker_task) {
+        return ERR_INVALID_TASK;
+    }
+
+    if (leader_task->pager != CURRENT_TASK
+        || worker_task->pager != CURRENT_TASK) {
+        return ERR_INVALID_TASK;
+    }
+
+    return task_join_service(leader_task, worker_task);
 }
 
 //发送通知。
@@ -236,7 +581,16 @@ static error_t sys_notify(task_t dst, notifications_t notifications) {
         return ERR_INVALID_TASK;
     }
 
-    notify(dst_task, notifications);
+    //异步通知需要记录发送方，因此单独处理
+    if (notifications & NOTIFY_ASYNC) {
+        notify_async(dst_task, CURRENT_TASK);
+        notifications &= ~NOTIFY_ASYNC;
+    }
+
+    if (notifications) {
+        notify(dst_task, notifications);
+    }
+
     return OK;
 }
 
@@ -291,14 +645,39 @@ static error_t sys_time(int timeout) {
         return ERR_INVALID_ARG;
     }
 
-    //更新超时时间
-    CURRENT_TASK->timeout = (timeout == 0) ? 0 : (timeout * (TICK_HZ / 1000));
+    //更新超时时间（定时器0）
+    struct timer *timer = &CURRENT_TASK->timers[0];
+    if (timeout) {
+        timer_start(timer, timeout);
+    } else {
+        timer_cancel(timer);
+    }
+
+    return OK;
+}
+
+//设置定时器 id。自调用以来指定的时间（以毫秒为单位）过去后，任务将收到 NOTIFY_TIMER
+//通知以及到期的定时器ID。如果 timeout 为零，则取消定时器。
+static error_t sys_timer_set(int id, int timeout) {
+    if (id < 0 || id >= TASK_TIMERS_MAX || timeout < 0) {
+        return ERR_INVALID_ARG;
+    }
+
+    struct task *current = CURRENT_TASK;
+    struct timer *timer = &current->timers[id];
+    if (timeout) {
+        timer_start(timer, timeout);
+    } else {
+        timer_cancel(timer);
+        current->timers_fired &= ~(1 << id);
+    }
+
     return OK;
 }
 
 //返回自启动以来经过的时间（以毫秒为单位）。
 static int sys_uptime(void) {
-    return uptime_ticks / TICK_HZ;
+    return arch_uptime() / TICK_HZ;
 }
 
 //关闭你的电脑。
@@ -311,7 +690,7 @@ long handle_syscall(long a0, long a1, long a2, long a3, long a4, long n) {
     long ret;
     switch (n) {
         case SYS_IPC:
-            ret = sys_ipc(a0, a1, (__user struct message *) a2, a3);
+            ret = sys_ipc(a0, a1, (__user struct message *) a2, a3, a4);
             break;
         case SYS_NOTIFY:
             ret = sys_notify(a0, a1);
@@ -337,6 +716,9 @@ long handle_syscall(long a0, long a1, long a2, long a3, long a4, long n) {
         case SYS_PM_ALLOC:
             ret = sys_pm_alloc(a0, a1, a2);
             break;
+        case SYS_PM_FREE:
+            ret = sys_pm_free(a0, a1, a2);
+            break;
         case SYS_VM_MAP:
             ret = sys_vm_map(a0, a1, a2, a3);
             break;
@@ -362,6 +744,39 @@ long handle_syscall(long a0, long a1, long a2, long a3, long a4, long n) {
         case SYS_SHUTDOWN:
             ret = sys_shutdown();
             break;
+        case SYS_OOL_WINDOW:
+            ret = sys_ool_window(a0, a1);
+            break;
+        case SYS_IPC_BATCH:
+            ret = sys_ipc_batch((__user struct ipc_batch_entry *) a0, a1);
+            break;
+        case SYS_SERVICE_JOIN:
+            ret = sys_service_join(a0, a1);
+            break;
+        case SYS_IPC_BUFFER:
+            ret = sys_ipc_buffer(a0);
+            break;
+        case SYS_TASK_SET_PRIORITY:
+            ret = sys_task_set_priority(a0, a1);
+            break;
+        case SYS_TIMER_SET:
+            ret = sys_timer_set(a0, a1);
+            break;
+        case SYS_TASK_SET_AFFINITY:
+            ret = sys_task_set_affinity(a0, a1);
+            break;
+        case SYS_TASK_SET_RESERVATION:
+            ret = sys_task_set_reservation(a0, a1, a2);
+            break;
+        case SYS_TASK_STATS:
+            ret = sys_task_stats(a0, (__user struct task_stats *) a1);
+            break;
+        case SYS_THREAD_CREATE:
+            ret = sys_thread_create(a0, a1, a2, a3);
+            break;
+        case SYS_THREAD_EXIT:
+            sys_thread_exit();
+            UNREACHABLE();
         default:
             ret = ERR_INVALID_ARG;
     }
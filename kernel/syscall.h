@@ -1,6 +1,16 @@
 #pragma once
+#include <libs/common/message.h>
 #include <libs/common/types.h>
 
+//寄存器IPC (SYS_IPC_FAST) 中通过寄存器传递的消息
+struct fast_message {
+    int32_t type;//消息类型
+    task_t src;//消息源（接收时由内核设置）
+    uint32_t data[IPC_FAST_WORDS];//消息数据
+};
+
 error_t memcpy_from_user(void *dst, __user const void *src, size_t len);
 error_t memcpy_to_user(__user void *dst, const void *src, size_t len);
 long handle_syscall(long a0, long a1, long a2, long a3, long a4, long n);
+error_t sys_ipc_fast(task_t dst, task_t src, unsigned flags,
+                     struct fast_message *fm);
@@ -3,55 +3,358 @@
 #include "ipc.h"
 #include "memory.h"
 #include "printk.h"
+#include "timer.h"
 #include <libs/common/list.h>
 #include <libs/common/string.h>
 
-static struct task tasks[NUM_TASKS_MAX];        //所有任务管理结构（包括未使用的）
+static struct task *tasks[NUM_TASKS_MAX];       //任务表（第 TASK_INDEX(tid) - 1 个）
+static unsigned num_tasks;                      //已经分配了管理结构的索引数
+static list_t free_tasks = LIST_INIT(free_tasks);  //未使用的管理结构列表
 static struct task idle_tasks[NUM_CPUS_MAX];    //每个CPU的空闲任务
-static list_t runqueue = LIST_INIT(runqueue);   //运行队列
 list_t active_tasks = LIST_INIT(active_tasks);  //正在使用的管理结构列表
-//选择下一个要执行的任务。
+
+//返回任务所在（或者最后所在）的运行队列。
+static list_t *runqueue_of(struct task *task) {
+    return &arch_cpuvar_of(task->cpu)->runqueues[task->priority];
+}
+
+//将可执行任务放入 task->cpu 的运行队列。还没有执行过的任务放入当前CPU的运行队列。
+static void enqueue_task(struct task *task, bool front) {
+    if (task->cpu < 0) {
+        task->cpu = CPUVAR->id;
+    }
+
+    if (front) {
+        list_push_front(runqueue_of(task), &task->waitqueue_next);
+    } else {
+        list_push_back(runqueue_of(task), &task->waitqueue_next);
+    }
+
+    arch_cpuvar_of(task->cpu)->runqueue_bitmap |= 1 << task->priority;
+}
+
+//任务是否可以在 cpuvar 上执行。如果CPU亲和性中的CPU都不在线（例如其他CPU还在启动），
+//则忽略CPU亲和性，允许在任何CPU上执行。
+static bool cpu_allowed(struct task *task, struct cpuvar *cpuvar) {
+    unsigned online = 0;
+    for (int id = 0; id < NUM_CPUS_MAX; id++) {
+        if (arch_cpuvar_of(id)->online) {
+            online |= 1 << id;
+        }
+    }
+
+    unsigned allowed = task->affinity & online;
+    return !allowed || (allowed & (1 << cpuvar->id)) != 0;
+}
+
+//更改任务所在的CPU。如果与上次执行的CPU不同，则记录为迁移。
+static void set_task_cpu(struct task *task, struct cpuvar *cpuvar) {
+    if (task->cpu >= 0 && task->cpu != cpuvar->id) {
+        task->stats.migrations++;
+    }
+
+    task->cpu = cpuvar->id;
+}
+
+//查找任务可以执行的空闲的CPU。优先选择当前CPU。没有空闲的CPU时返回 NULL。
+static struct cpuvar *find_idle_cpu(struct task *task) {
+    if (CPUVAR->idle && cpu_allowed(task, CPUVAR)) {
+        return CPUVAR;
+    }
+
+    for (int id = 0; id < NUM_CPUS_MAX; id++) {
+        struct cpuvar *cpuvar = arch_cpuvar_of(id);
+        if (cpuvar->online && cpuvar->idle && cpu_allowed(task, cpuvar)) {
+            return cpuvar;
+        }
+    }
+
+    return NULL;
+}
+
+//为被唤醒的任务选择CPU。为了利用缓存和TLB中残留的数据，优先选择上次执行该任务的
+//CPU。但是，如果那个CPU正忙而有空闲的CPU，则选择空闲的CPU，使任务立即开始执行。
+//只选择CPU亲和性允许的CPU。
+static struct cpuvar *select_cpu(struct task *task) {
+    struct cpuvar *last = (task->cpu < 0) ? CPUVAR : arch_cpuvar_of(task->cpu);
+    bool last_allowed = cpu_allowed(task, last);
+    if (last->idle && last_allowed) {
+        return last;
+    }
+
+    struct cpuvar *idle = find_idle_cpu(task);
+    if (idle) {
+        return idle;
+    }
+
+    //所有CPU都在忙。如果能抢占上次的CPU上正在运行的任务，则仍然选择那个CPU，否则放入
+    //当前CPU的运行队列：返回用户模式之前会为时间片设置定时器（timer_reprogram函数）。
+    if (last_allowed
+        && (last == CPUVAR
+            || task->priority < last->current_task->priority)) {
+        return last;
+    }
+
+    if (cpu_allowed(task, CPUVAR)) {
+        return CPUVAR;
+    }
+
+    //当前CPU也不允许：选择允许的CPU中的第一个。
+    for (int id = 0; id < NUM_CPUS_MAX; id++) {
+        struct cpuvar *cpuvar = arch_cpuvar_of(id);
+        if (cpuvar->online && cpu_allowed(task, cpuvar)) {
+            return cpuvar;
+        }
+    }
+
+    UNREACHABLE();
+}
+
+//任务被放入了 cpuvar 的运行队列，让那个CPU重新选择要执行的任务。其他CPU没有周期性的
+//定时器中断，因此只向该CPU发送IPI。空闲的CPU收到IPI后就不再是空闲的，以免多个任务被
+//分配到同一个CPU。
+static void kick_cpu(struct cpuvar *cpuvar) {
+    if (cpuvar != CPUVAR) {
+        cpuvar->idle = false;
+        arch_send_ipi_to(cpuvar->id, IPI_RESCHEDULE);
+    }
+}
+
+//将可执行任务放入 select_cpu 函数选择的CPU的运行队列。
+static void wake_task(struct task *task) {
+    struct cpuvar *cpuvar = select_cpu(task);
+    set_task_cpu(task, cpuvar);
+    enqueue_task(task, false);
+    kick_cpu(cpuvar);
+}
+
+//返回 cpuvar 的运行队列中最高的优先级。没有可执行任务时返回 TASK_PRIORITY_MAX。
+//
+//任务可能通过 list_remove 函数直接从运行队列中删除，因此位图中的位只是提示：
+//在这里发现运行队列为空时清除该位。
+static int highest_priority(struct cpuvar *cpuvar) {
+    while (cpuvar->runqueue_bitmap) {
+        int priority = __builtin_ctz(cpuvar->runqueue_bitmap);
+        if (!list_is_empty(&cpuvar->runqueues[priority])) {
+            return priority;
+        }
+
+        cpuvar->runqueue_bitmap &= ~(1 << priority);
+    }
+
+    return TASK_PRIORITY_MAX;
+}
+
+//从 cpuvar 的运行队列中取出优先级最高的任务。
+static struct task *dequeue_task(struct cpuvar *cpuvar) {
+    int priority = highest_priority(cpuvar);
+    if (priority == TASK_PRIORITY_MAX) {
+        return NULL;
+    }
+
+    return LIST_POP_FRONT(&cpuvar->runqueues[priority], struct task,
+                          waitqueue_next);
+}
+
+//返回 cpuvar 的运行队列中的任务数。
+static size_t num_queued_tasks(struct cpuvar *cpuvar) {
+    size_t len = 0;
+    for (int i = 0; i < TASK_PRIORITY_MAX; i++) {
+        len += list_len(&cpuvar->runqueues[i]);
+    }
+
+    return len;
+}
+
+//返回 cpuvar 的运行队列中可以在当前CPU上执行的优先级最高的任务。
+static struct task *find_stealable(struct cpuvar *cpuvar) {
+    for (int i = 0; i < TASK_PRIORITY_MAX; i++) {
+        LIST_FOR_EACH (task, &cpuvar->runqueues[i], struct task,
+                       waitqueue_next) {
+            if (cpu_allowed(task, CPUVAR)) {
+                return task;
+            }
+        }
+    }
+
+    return NULL;
+}
+
+//从可执行任务最多的CPU的运行队列中偷取一个任务。用于当前CPU无事可做的时候。
+static struct task *steal_task(void) {
+    struct task *victim = NULL;
+    size_t busiest_len = 0;
+    for (int id = 0; id < NUM_CPUS_MAX; id++) {
+        struct cpuvar *cpuvar = arch_cpuvar_of(id);
+        if (!cpuvar->online || cpuvar == CPUVAR) {
+            continue;
+        }
+
+        size_t len = num_queued_tasks(cpuvar);
+        if (len <= busiest_len) {
+            continue;
+        }
+
+        struct task *task = find_stealable(cpuvar);
+        if (task) {
+            victim = task;
+            busiest_len = len;
+        }
+    }
+
+    if (!victim) {
+        return NULL;
+    }
+
+    list_remove(&victim->waitqueue_next);
+    set_task_cpu(victim, CPUVAR);
+    return victim;
+}
+
+//选择下一个要执行的任务。优先级高的任务总是先执行，相同优先级的任务按顺序轮流执行。
 static struct task *scheduler(void) {
-    //从运行队列中检索可执行任务。
-    struct task *next = LIST_POP_FRONT(&runqueue, struct task, waitqueue_next);
+    struct task *current = CURRENT_TASK;
+    bool current_runnable = current != IDLE_TASK
+                            && current->state == TASK_RUNNABLE
+                            && !current->destroyed
+                            && cpu_allowed(current, CPUVAR);
+
+    //如果正在运行的任务的优先级比运行队列中的任何任务都高，则继续执行它。
+    if (current_runnable
+        && current->priority < highest_priority(CPUVAR)) {
+        return current;
+    }
+
+    //从当前CPU的运行队列中检索优先级最高的可执行任务。
+    struct task *next = dequeue_task(CPUVAR);
     if (next) {
         return next;
     }
 
-    if (CURRENT_TASK->state == TASK_RUNNABLE && !CURRENT_TASK->destroyed) {
+    if (current_runnable) {
         //如果没有其他任务可以执行，则继续正在运行的任务。
-        return CURRENT_TASK;
+        return current;
+    }
+
+    //当前CPU即将空闲：从其他CPU的运行队列中偷取任务。
+    next = steal_task();
+    if (next) {
+        return next;
     }
 
     return IDLE_TASK;//如果没有任务可运行，则运行空闲任务。
 }
 
-//初始化任务管理结构。
+//任务的定时器到期：通知任务是哪个定时器到期了。
+static void task_timer_expired(struct timer *timer) {
+    timer->task->timers_fired |= 1 << timer->id;
+    notify(timer->task, NOTIFY_TIMER);
+}
+
+//IPC超时：中断正在等待的发送/接收处理
+static void ipc_timer_expired(struct timer *timer) {
+    ipc_expire(timer->task);
+}
+
+static void change_priority(struct task *task, int priority);
+
+//新的周期开始：补充预留CPU时间。如果任务因为用完了预留CPU时间而降低了优先级，则恢复
+//为预留的优先级。
+static void reservation_replenish(struct timer *timer) {
+    struct task *task = timer->task;
+    bool throttled = !task->rsv_remaining;
+    task->rsv_remaining = task->rsv_budget;
+    timer_start(timer, task->rsv_period / (TICK_HZ / 1000));
+
+    if (throttled) {
+        change_priority(task, TASK_PRIORITY_RESERVED);
+
+        //任务在其他CPU的运行队列中等待时，让那个CPU重新选择要执行的任务。当前CPU
+        //会在定时器中断处理程序中调用task_preempt函数。
+        if (task->state == TASK_RUNNABLE && task->cpu >= 0
+            && task->cpu != CPUVAR->id) {
+            arch_send_ipi_to(task->cpu, IPI_RESCHEDULE);
+        }
+    }
+}
+
+//初始化任务管理结构。process 不为 NULL 时，作为 process 的线程共享其地址空间。
 static error_t init_task_struct(struct task *task, task_t tid, const char *name,
-                                vaddr_t ip, struct task *pager,
-                                vaddr_t kernel_entry, void *arg) {
+                                vaddr_t ip, uaddr_t sp, struct task *pager,
+                                struct task *process, vaddr_t kernel_entry,
+                                void *arg) {
     task->tid = tid;
     task->destroyed = false;
+    task->cpu = -1;
+    task->priority = TASK_PRIORITY_DEFAULT;
+    task->base_priority = TASK_PRIORITY_DEFAULT;
+    task->affinity = TASK_AFFINITY_ALL;
     task->quantum = 0;
-    task->timeout = 0;
+    task->charge_us = 0;
+    task->donor = 0;
+    for (int i = 0; i < TASK_TIMERS_MAX; i++) {
+        timer_init(&task->timers[i], task, i, task_timer_expired);
+    }
+
+    task->timers_fired = 0;
+    timer_init(&task->ipc_timer, task, -1, ipc_timer_expired);
+    task->rsv_budget = 0;
+    task->rsv_period = 0;
+    task->rsv_remaining = 0;
+    timer_init(&task->rsv_timer, task, -1, reservation_replenish);
+    task->woken_at = 0;
+    memset(&task->stats, 0, sizeof(task->stats));
+    task->ipc_expired = false;
+    task->ipc_cancelable = false;
+    task->ipc_canceled = false;
     task->wait_for = IPC_DENY;
+    task->ipc_open_recv = false;
     task->ref_count = 0;
     task->pager = pager;
+    task->process = process ? process : task;
+    list_init(&task->threads);
+    list_elem_init(&task->thread_next);
+    task->ool_window = 0;
+    task->ool_window_size = 0;
+    task->ipc_buffer = NULL;
+    task->ipc_buffer_uaddr = 0;
+    task->ipc_buffer_paddr = 0;
+    task->ipc_buffer_recv = false;
+    task->ipc_buffer_filled = false;
+    task->async_summary = 0;
+    memset(task->async_pending, 0, sizeof(task->async_pending));
 
     strcpy_safe(task->name, sizeof(task->name), name);
     list_elem_init(&task->waitqueue_next);
     list_elem_init(&task->next);
     list_init(&task->senders);
     list_init(&task->pages);
-
-    error_t err = arch_vm_init(&task->vm);
-    if (err != OK) {
-        return err;
+    task->service = NULL;
+    list_init(&task->workers);
+    list_elem_init(&task->worker_next);
+
+    //异步消息的内核邮箱在第一次收到异步消息时分配
+    task->mailbox = NULL;
+    task->mailbox_paddr = 0;
+    task->mailbox_head = 0;
+    task->mailbox_len = 0;
+
+    //线程使用 process 的页表
+    if (!process) {
+        error_t err = arch_vm_init(&task->vm);
+        if (err != OK) {
+            return err;
+        }
     }
 
-    err = arch_task_init(task, ip, kernel_entry, arg);
+    //用户任务的第一次执行也是续体，由 arch_task_init 设置
+    task->continuation = NULL;
+    error_t err = arch_task_init(task, ip, sp, kernel_entry, arg);
     if (err != OK) {
-        arch_vm_destroy(&task->vm);
+        if (!process) {
+            arch_vm_destroy(&task->vm);
+        }
+
         return err;
     }
 
@@ -67,14 +370,32 @@ static error_t init_task_struct(struct task *task, task_t tid, const char *name,
 //回来。否则，执行转移到另一个任务，下次再调度该任务
 //回来。
 void task_switch(void) {
+    //将到现在为止的时间计入切换前的任务。用完了预留CPU时间的任务在选择下一个任务之前
+    //降低优先级。
+    task_account();
+
     struct task *prev = CURRENT_TASK;//运行任务
     struct task *next = scheduler();//下一个要执行的任务
 
-    //将 CPU 时间分配给下一个要运行的任务
-    if (next != IDLE_TASK) {
+    //记录被唤醒的任务等了多久才开始执行。
+    if (next->woken_at) {
+        unsigned latency = arch_clock_elapsed_us(&next->woken_at);
+        next->woken_at = 0;
+        next->stats.wakeups++;
+        next->stats.wakeup_latency += latency;
+        next->stats.wakeup_latency_max =
+            MAX(next->stats.wakeup_latency_max, latency);
+    }
+
+    //将 CPU 时间分配给下一个要运行的任务。通过IPC直接交接而获得了调用方剩余CPU时间的
+//任务则直接使用转让过来的时间。
+    if (next != IDLE_TASK && !next->quantum) {
         next->quantum = TASK_QUANTUM;
     }
 
+    //记录该CPU是否空闲，使唤醒任务的CPU可以选择它。
+    CPUVAR->idle = next == IDLE_TASK;
+
     if (next == prev) {
         //除了当前正在运行的任务之外，没有其他可执行任务。返回并继续处理。
         return;
@@ -82,33 +403,90 @@ void task_switch(void) {
 
     if (prev->state == TASK_RUNNABLE) {
         //如果正在进行的任务可执行，则将其返回到可执行任务队列。
-//当分配的 CPU 时间用完时发生。
-        list_push_back(&runqueue, &prev->waitqueue_next);
+//当分配的 CPU 时间用完时发生。如果CPU亲和性不再允许在该CPU上执行，则移到其他CPU。
+        if (cpu_allowed(prev, CPUVAR)) {
+            enqueue_task(prev, false);
+        } else {
+            wake_task(prev);
+        }
+
+        prev->stats.involuntary_switches++;
+    } else {
+        //阻塞（等待消息等）而自愿让出CPU
+        prev->stats.voluntary_switches++;
     }
 
     //切换任务
+    next->cpu = CPUVAR->id;
     CURRENT_TASK = next;
     arch_task_switch(prev, next);
 }
 
-//查找未使用的任务 ID。
-static task_t alloc_tid(void) {
-    for (task_t i = 0; i < NUM_TASKS_MAX; i++) {
-        if (tasks[i].state == TASK_UNUSED) {
-            return i + 1;
-        }
+//不保留内核栈而切换任务。调用方需要先阻塞正在运行的任务（或者以可执行状态让出
+//CPU）。任务恢复时在新的内核栈上执行 continuation，调用方的栈帧全部被丢弃，因此
+//continuation 需要的状态必须事先保存在任务管理结构中。
+__noreturn void task_switch_continue(continuation_t continuation) {
+    struct task *current = CURRENT_TASK;
+    current->continuation = continuation;
+    task_switch();
+
+    //没有其他可执行任务（本任务仍然可执行）：在当前的内核栈上继续执行。
+    current->continuation = NULL;
+    continuation();
+}
+
+//扩展任务表：分配 TASK_TABLE_CHUNK 个任务管理结构，并放入未使用的管理结构列表。任务
+//管理结构不会被释放，任务结束后用于新的任务。
+static bool grow_task_table(void) {
+    if (num_tasks >= NUM_TASKS_MAX) {
+        return false;
+    }
+
+    size_t num = MIN(TASK_TABLE_CHUNK, NUM_TASKS_MAX - num_tasks);
+    paddr_t paddr = pm_alloc(sizeof(struct task) * num, NULL, PM_ALLOC_ZEROED);
+    if (!paddr) {
+        return false;
+    }
+
+    struct task *chunk = (struct task *) arch_paddr_to_vaddr(paddr);
+    for (size_t i = 0; i < num; i++) {
+        struct task *task = &chunk[i];
+        task->tid = ++num_tasks;//第0代的任务ID和索引相同
+        task->state = TASK_UNUSED;
+        list_elem_init(&task->next);
+        list_push_back(&free_tasks, &task->next);
+        tasks[num_tasks - 1] = task;
     }
 
-    return 0;
+    return true;
 }
 
-//从任务ID获取任务管理结构。如果不存在或具有无效 id，则返回 null。
-struct task *task_find(task_t tid) {
-    if (tid < 0 || tid >= NUM_TASKS_MAX) {
+//分配未使用的任务管理结构。task->tid 是该任务要使用的任务ID。没有时返回 NULL。
+static struct task *alloc_task(void) {
+    if (list_is_empty(&free_tasks) && !grow_task_table()) {
         return NULL;
     }
 
-    struct task *task = &tasks[tid - 1];
+    return LIST_POP_FRONT(&free_tasks, struct task, next);
+}
+
+//归还任务管理结构。更新代，使旧的任务ID失效。放在列表的末尾，尽量推迟同一索引的
+//重复使用。代用完后回到第0代。为了避免有符号整数溢出，用无符号整数计算，并且屏蔽
+//符号位使任务ID保持为正数（负数会被 IS_ERROR 当作错误）。
+static void free_task(struct task *task) {
+    unsigned next_tid = (unsigned) task->tid + (1u << TASK_INDEX_BITS);
+    task->tid = (task_t) (next_tid & INT_MAX);
+    list_push_back(&free_tasks, &task->next);
+}
+
+//从任务表的索引（1～NUM_TASKS_MAX）获取正在使用的任务管理结构。如果不存在，则返回
+//NULL。
+struct task *task_find_by_index(unsigned index) {
+    if (index == 0 || index > num_tasks) {
+        return NULL;
+    }
+
+    struct task *task = tasks[index - 1];
     if (task->state == TASK_UNUSED) {
         return NULL;
     }
@@ -116,6 +494,21 @@ struct task *task_find(task_t tid) {
     return task;
 }
 
+//从任务ID获取任务管理结构。如果不存在或具有无效 id（包括已经结束的任务的ID），则
+//返回 null。
+struct task *task_find(task_t tid) {
+    if (tid <= 0) {
+        return NULL;
+    }
+
+    struct task *task = task_find_by_index(TASK_INDEX(tid));
+    if (!task || task->tid != tid) {
+        return NULL;
+    }
+
+    return task;
+}
+
 //将任务置于阻塞状态。如果你想阻止正在运行的任务本身，请使用task_switch函数。
 //有必要调用它并将执行转移到另一个任务。
 void task_block(struct task *task) {
@@ -123,6 +516,7 @@ void task_block(struct task *task) {
     DEBUG_ASSERT(task->state == TASK_RUNNABLE);
 
     task->state = TASK_BLOCKED;
+    task->quantum = 0;//再次执行时重新分配CPU时间
 }
 
 //使任务可执行。
@@ -130,22 +524,216 @@ void task_resume(struct task *task) {
     DEBUG_ASSERT(task->state == TASK_BLOCKED);
 
     task->state = TASK_RUNNABLE;
-    list_push_back(&runqueue, &task->waitqueue_next);
+    task->woken_at = arch_clock();
+    wake_task(task);
+}
+
+//使任务可执行，并插入到当前CPU的运行队列的开头（IPC直接交接）。由于持有内核锁，
+//当前CPU下一次调用task_switch函数时会立即切换到该任务，而不必排在其他可执行任务
+//之后。
+//
+//如果quantum不为零，则将其作为该任务的剩余CPU时间。用于将调用方剩余的CPU时间
+//转让给处理请求的任务。
+void task_handoff(struct task *task, unsigned quantum) {
+    DEBUG_ASSERT(task->state == TASK_BLOCKED);
+    DEBUG_ASSERT(task != IDLE_TASK);
+
+    task->state = TASK_RUNNABLE;
+    task->quantum = quantum;
+    task->woken_at = arch_clock();
+    if (!cpu_allowed(task, CPUVAR)) {
+        //CPU亲和性不允许在当前CPU上执行：像普通的唤醒一样处理
+        wake_task(task);
+        return;
+    }
+
+    set_task_cpu(task, CPUVAR);
+    enqueue_task(task, true);
+}
+
+//将调用方 (lender) 在运行队列中的位置和剩余CPU时间借给正在处理其他请求的服务器。
+//如果服务器在运行队列中等待，则将它移到开头，并把调用方剩余的CPU时间转移给它，使它
+//尽快处理完当前的请求并接收调用方的消息。调用方接下来会阻塞，恢复时重新分配CPU时间。
+//正在其他CPU上运行的服务器不需要移动。
+void task_lend(struct task *task, struct task *lender) {
+    if (task->state != TASK_RUNNABLE
+        || !list_contains(runqueue_of(task), &task->waitqueue_next)) {
+        return;
+    }
+
+    list_remove(&task->waitqueue_next);
+    enqueue_task(task, true);
+
+    //剩余CPU时间为0的任务在下次执行时获得 TASK_QUANTUM，在此基础上加上借来的时间
+    unsigned quantum = task->quantum ? task->quantum : TASK_QUANTUM;
+    task->quantum = quantum + lender->quantum;
+    lender->quantum = 0;
+}
+
+//更改任务实际使用的优先级。如果任务在运行队列中等待，则移到新优先级的运行队列。提高了
+//优先级时，让那个CPU重新选择要执行的任务，以免等到它的下一次定时器中断。
+static void change_priority(struct task *task, int priority) {
+    bool queued = task->state == TASK_RUNNABLE
+                  && list_contains(runqueue_of(task), &task->waitqueue_next);
+    if (queued) {
+        list_remove(&task->waitqueue_next);
+    }
+
+    bool raised = priority < task->priority;
+    task->priority = priority;
+    if (queued) {
+        enqueue_task(task, false);
+        if (raised) {
+            kick_cpu(arch_cpuvar_of(task->cpu));
+        }
+    }
+}
+
+//任务是否还有本周期的预留CPU时间。
+static bool reservation_active(struct task *task) {
+    return task->rsv_budget && task->rsv_remaining;
+}
+
+//更改任务的优先级。有预留CPU时间的任务在用完预留CPU时间之后使用该优先级。
+void task_set_priority(struct task *task, int priority) {
+    DEBUG_ASSERT(0 <= priority && priority < TASK_PRIORITY_MAX);
+
+    task->base_priority = priority;
+    if (!reservation_active(task)) {
+        change_priority(task, priority);
+    }
+}
+
+//为任务预留CPU时间：每个 period 中的 budget 以 TASK_PRIORITY_RESERVED 优先级执行，
+//即使有其他任务一直占用CPU也能得到处理。用完之后直到下一个周期以普通的优先级执行。
+//budget 为零时取消预留。单位都是tick。
+void task_set_reservation(struct task *task, unsigned budget, unsigned period) {
+    DEBUG_ASSERT(budget <= period && period <= TASK_RESERVATION_PERIOD_MAX);
+
+    timer_cancel(&task->rsv_timer);
+    task->rsv_budget = budget;
+    task->rsv_period = period;
+    task->rsv_remaining = budget;
+    if (budget) {
+        timer_start(&task->rsv_timer, period / (TICK_HZ / 1000));
+    }
+
+    change_priority(task, reservation_active(task) ? TASK_PRIORITY_RESERVED
+                                                   : task->base_priority);
+}
+
+//从正在运行的任务的预留CPU时间中扣除 ticks。用完时降低为普通的优先级，并记录为超支，
+//返回 true：调用方需要切换任务。
+static bool charge_reservation(struct task *task, unsigned ticks) {
+    if (!reservation_active(task)) {
+        return false;
+    }
+
+    task->rsv_remaining -= MIN(ticks, task->rsv_remaining);
+    if (task->rsv_remaining) {
+        return false;
+    }
+
+    task->stats.rsv_overruns++;
+    change_priority(task, task->base_priority);
+    return true;
+}
+
+//更改任务的CPU亲和性（可以执行该任务的CPU的位图）。如果任务现在所在的CPU不再被
+//允许，则将它移到允许的CPU。
+void task_set_affinity(struct task *task, unsigned affinity) {
+    task->affinity = affinity;
+    if (task->state != TASK_RUNNABLE || task->cpu < 0) {
+        return;
+    }
+
+    struct cpuvar *cpuvar = arch_cpuvar_of(task->cpu);
+    if (cpu_allowed(task, cpuvar)) {
+        return;
+    }
+
+    if (list_contains(runqueue_of(task), &task->waitqueue_next)) {
+        //在运行队列中等待：移到允许的CPU的运行队列
+        list_remove(&task->waitqueue_next);
+        wake_task(task);
+    } else if (task == CURRENT_TASK) {
+        //正在当前CPU上运行：切换任务时会被移到允许的CPU
+        task_switch();
+    } else if (cpuvar->current_task == task) {
+        //正在其他CPU上运行：让那个CPU切换任务
+        arch_send_ipi_to(cpuvar->id, IPI_RESCHEDULE);
+    }
+}
+
+//将自上次计算以来经过的时间计入正在运行的任务：计入执行时间，并从剩余CPU时间和预留
+//CPU时间中扣除。在定时器中断和任务切换时调用，因此阻塞或让出CPU之前运行的时间（不满
+//一个tick的部分也累积起来）都会被扣除。空闲任务的时间不计入。用完了预留CPU时间时
+//返回 true。
+bool task_account(void) {
+    unsigned elapsed = arch_clock_elapsed_us(&CPUVAR->account_clock);
+    struct task *current = CURRENT_TASK;
+    if (current == IDLE_TASK) {
+        return false;
+    }
+
+    current->stats.runtime += elapsed;
+    current->charge_us += elapsed;
+    unsigned ticks = current->charge_us / TICK_US;
+    current->charge_us %= TICK_US;
+    current->quantum -= MIN(ticks, current->quantum);
+    return charge_reservation(current, ticks);
+}
+
+//获取任务的调度统计信息。
+void task_get_stats(struct task *task, struct task_stats *stats) {
+    *stats = task->stats;
+    stats->tid = task->tid;
+    strcpy_safe(stats->name, sizeof(stats->name), task->name);
+    stats->priority = task->priority;
+    stats->cpu = task->cpu;
+}
+
+//返回正在运行的任务的时间片用完时是否需要切换任务，即当前CPU的运行队列中是否有
+//优先级不低于正在运行的任务的任务。不需要切换时，不必为时间片设置定时器中断。
+bool task_contended(void) {
+    return highest_priority(CPUVAR) <= CURRENT_TASK->priority;
+}
+
+//如果当前CPU的运行队列中有优先级比正在运行的任务更高的任务，则切换到该任务。用于
+//中断处理程序唤醒了高优先级任务（如设备驱动程序）的时候，不必等到时间片用完。
+void task_preempt(void) {
+    struct task *current = CURRENT_TASK;
+    if (current != IDLE_TASK && highest_priority(CPUVAR) < current->priority) {
+        task_switch();
+    }
+}
+
+//将 worker 作为 leader 的工作任务加入服务。之后发往 leader 的请求会被分派给
+//空闲的工作任务（包括 leader 本身）。
+error_t task_join_service(struct task *leader, struct task *worker) {
+    if (leader == worker || leader->service || worker->service
+        || !list_is_empty(&worker->workers)) {
+        return ERR_INVALID_ARG;
+    }
+
+    worker->service = leader;
+    list_push_back(&leader->workers, &worker->worker_next);
+    return OK;
 }
 
 //创建任务。 ip 是在用户模式下运行的地址（入口点），寻呼机是
 //寻呼机任务。
 task_t task_create(const char *name, uaddr_t ip, struct task *pager) {
-    task_t tid = alloc_tid();
-    if (!tid) {
+    struct task *task = alloc_task();
+    if (!task) {
         return ERR_TOO_MANY_TASKS;
     }
 
-    struct task *task = &tasks[tid - 1];
-    DEBUG_ASSERT(task != NULL);
-
-    error_t err = init_task_struct(task, tid, name, ip, pager, 0, NULL);
+    task_t tid = task->tid;
+    error_t err =
+        init_task_struct(task, tid, name, ip, 0, pager, NULL, 0, NULL);
     if (err != OK) {
+        list_push_front(&free_tasks, &task->next);
         return err;
     }
 
@@ -155,20 +743,50 @@ task_t task_create(const char *name, uaddr_t ip, struct task *pager) {
     return tid;
 }
 
+//创建 process 的线程。线程与 process 共享地址空间（页表和内存页），但有自己的内核栈、
+//执行上下文和IPC状态，可以与其他线程同时在不同的CPU上执行。ip、sp 和 arg 是用户模式
+//的执行起始地址、栈指针和第一个参数（a0 寄存器）。
+task_t thread_create(struct task *process, uaddr_t ip, uaddr_t sp,
+                     uaddr_t arg) {
+    DEBUG_ASSERT(process->process == process);
+
+    struct task *task = alloc_task();
+    if (!task) {
+        return ERR_TOO_MANY_TASKS;
+    }
+
+    task_t tid = task->tid;
+    error_t err = init_task_struct(task, tid, process->name, ip, sp,
+                                   process->pager, process, 0, (void *) arg);
+    if (err != OK) {
+        list_push_front(&free_tasks, &task->next);
+        return err;
+    }
+
+    //继承主线程的调度设置
+    task_set_priority(task, process->base_priority);
+    task->affinity = process->affinity;
+
+    list_push_back(&process->threads, &task->thread_next);
+    list_push_back(&active_tasks, &task->next);
+    task_resume(task);
+    TRACE("created a thread of \"%s\" (tid=%d)", process->name, tid);
+    return tid;
+}
+
 //创建 HinaVM 任务。 insts 为 HinaVM 指令序列，num_insts 为指令数量，pager 为分页任务。之所以写在这里而不是hinavm.c，是为了调用init_task_struct函数等。
 task_t hinavm_create(const char *name, hinavm_inst_t *insts, uint32_t num_insts,
                      struct task *pager) {
-    task_t tid = alloc_tid();
-    if (!tid) {
+    struct task *task = alloc_task();
+    if (!task) {
         return ERR_TOO_MANY_TASKS;
     }
 
-    struct task *task = &tasks[tid - 1];
-    DEBUG_ASSERT(task != NULL);
-
+    task_t tid = task->tid;
     size_t hinavm_size = ALIGN_UP(sizeof(struct hinavm), PAGE_SIZE);
     paddr_t hinavm_paddr = pm_alloc(hinavm_size, NULL, PM_ALLOC_UNINITIALIZED);
     if (!hinavm_paddr) {
+        list_push_front(&free_tasks, &task->next);
         return ERR_NO_MEMORY;
     }
 
@@ -176,10 +794,11 @@ task_t hinavm_create(const char *name, hinavm_inst_t *insts, uint32_t num_insts,
     memcpy(&hinavm->insts, insts, sizeof(hinavm_inst_t) * num_insts);
     hinavm->num_insts = num_insts;
 
-    error_t err = init_task_struct(task, tid, name, 0, pager,
+    error_t err = init_task_struct(task, tid, name, 0, 0, pager, NULL,
                                    (vaddr_t) hinavm_run, hinavm);
     if (err != OK) {
         pm_free(hinavm_paddr, hinavm_size);
+        list_push_front(&free_tasks, &task->next);
         return err;
     }
 
@@ -212,6 +831,14 @@ error_t task_destroy(struct task *task) {
         return ERR_STILL_USED;
     }
 
+    //先删除共享地址空间的所有线程。
+    LIST_FOR_EACH (thread, &task->threads, struct task, thread_next) {
+        error_t err = task_destroy(thread);
+        if (err != OK) {
+            return err;
+        }
+    }
+
     TRACE("destroying a task \"%s\" (tid=%d)", task->name, task->tid);
 
     //通过记录删除正在进行中，接收到以下处理器间中断的其他CPU可以
@@ -227,7 +854,7 @@ error_t task_destroy(struct task *task) {
         }
 
         //即使任务已准备好运行，如果它未包含在运行队列中，则当前不会执行该任务。
-        if (list_contains(&runqueue, &task->waitqueue_next)) {
+        if (list_contains(runqueue_of(task), &task->waitqueue_next)) {
             break;
         }
 
@@ -240,44 +867,83 @@ error_t task_destroy(struct task *task) {
         notify(sender, NOTIFY_ABORTED);
     }
 
-    //从内核中删除任务。
+    //清除该任务留在其他任务中的异步通知，以免索引被重复使用后误报发送方。
+    forget_async_source(task);
+
+    //退出所属的服务。如果是服务的代表任务，则解散其工作任务。
+    if (task->service) {
+        list_remove(&task->worker_next);
+    }
+
+    LIST_FOR_EACH (worker, &task->workers, struct task, worker_next) {
+        list_remove(&worker->worker_next);
+        worker->service = NULL;
+    }
+
+    //取消所有定时器。
+    for (int i = 0; i < TASK_TIMERS_MAX; i++) {
+        timer_cancel(&task->timers[i]);
+    }
+
+    timer_cancel(&task->ipc_timer);
+    timer_cancel(&task->rsv_timer);
+
+    //从内核中删除任务。地址空间只在删除主线程时释放。
     list_remove(&task->next);
     list_remove(&task->waitqueue_next);
-    arch_vm_destroy(&task->vm);
+    list_remove(&task->thread_next);
+    if (task->ipc_buffer) {
+        pm_free(task->ipc_buffer_paddr, PAGE_SIZE);
+    }
+    if (task->process == task) {
+        arch_vm_destroy(&task->vm);
+        pm_free_by_list(&task->pages);
+    }
     arch_task_destroy(task);
-    pm_free_by_list(&task->pages);
+    if (task->mailbox) {
+        pm_free(task->mailbox_paddr, TASK_MAILBOX_SIZE);
+    }
     task->state = TASK_UNUSED;
     task->pager->ref_count--;
+    free_task(task);
     return OK;
 }
 
-//终止正在运行的任务 (CURRENT_TASK)。参数异常是终止的原因。
-__noreturn void task_exit(int exception) {
-    struct task *pager = CURRENT_TASK->pager;
-    ASSERT(pager != NULL);
-
-    TRACE("exiting a task \"%s\" (tid=%d)", CURRENT_TASK->name,
-          CURRENT_TASK->tid);
-
-    //通知寻呼任务终止原因。寻呼任务调用task_destroy系统调用。
-//调用这个实际上会删除这个任务。
-    struct message m;
-    m.type = EXCEPTION_MSG;
-    m.exception.task = CURRENT_TASK->tid;
-    m.exception.reason = exception;
-    error_t err = ipc(CURRENT_TASK->pager, IPC_DENY,
-                      (__user struct message *) &m, IPC_SEND | IPC_KERNEL);
+//已经结束的任务的续体。结束的任务不会被恢复。
+__noreturn static void exited_task_resumed(void) {
+    PANIC("%s: resumed an exited task", CURRENT_TASK->name);
+}
 
+//通知寻呼任务终止原因后的处理。
+__noreturn static void task_exit_done(error_t err) {
+    struct task *current = CURRENT_TASK;
     if (err != OK) {
-        WARN("%s: failed to send an exit message to '%s': %s",
-             CURRENT_TASK->name, pager->name, err2str(err));
+        WARN("%s: failed to send an exit message to '%s': %s", current->name,
+             current->pager->name, err2str(err));
     }
 
-    //执行其他任务。我再也不会回到这个任务了。
-    task_block(CURRENT_TASK);
-    task_switch();
+    //执行其他任务。我再也不会回到这个任务了，因此不需要保留内核栈。
+    task_block(current);
+    task_switch_continue(exited_task_resumed);
+}
 
-    UNREACHABLE();
+//终止正在运行的任务 (CURRENT_TASK)。参数异常是终止的原因。
+__noreturn void task_exit(int exception) {
+    struct task *current = CURRENT_TASK;
+    ASSERT(current->pager != NULL);
+
+    TRACE("exiting a task \"%s\" (tid=%d)", current->name, current->tid);
+
+    //通知寻呼任务终止原因。寻呼任务调用task_destroy系统调用。
+//调用这个实际上会删除这个任务。寻呼任务忙时不保留内核栈而等待。
+    struct message *m = &current->m;
+    m->type = EXCEPTION_MSG;
+    m->exception.task = current->tid;
+    m->exception.reason = exception;
+    current->cont_done = task_exit_done;
+    error_t err = ipc(current->pager, IPC_DENY, (__user struct message *) m,
+                      IPC_SEND | IPC_KERNEL | IPC_CONTINUE);
+    task_exit_done(err);
 }
 
 //显示每个任务的当前状态以进行调试。对于发生死锁时调查原因很有用。
@@ -287,7 +953,15 @@ void task_dump(void) {
     LIST_FOR_EACH (task, &active_tasks, struct task, next) {
         switch (task->state) {
             case TASK_RUNNABLE:
-                WARN("  #%d: %s: RUNNABLE", task->tid, task->name);
+                WARN("  #%d: %s: RUNNABLE (cpu=%d, affinity=%x, migrations=%u)",
+                     task->tid, task->name, task->cpu, task->affinity,
+                     task->stats.migrations);
+                if (task->rsv_budget) {
+                    WARN("    reservation: %u/%u ticks (remaining=%u, "
+                         "overruns=%u)",
+                         task->rsv_budget, task->rsv_period,
+                         task->rsv_remaining, task->stats.rsv_overruns);
+                }
                 LIST_FOR_EACH (sender, &task->senders, struct task,
                                waitqueue_next) {
                     WARN("    blocked sender: #%d: %s", sender->tid,
@@ -320,7 +994,15 @@ void task_dump(void) {
 void task_init_percpu(void) {
     //为每个CPU创建一个空闲任务，并将其设为运行任务。
     struct task *idle_task = &idle_tasks[CPUVAR->id];
-    ASSERT_OK(init_task_struct(idle_task, 0, "(idle)", 0, NULL, 0, NULL));
+    ASSERT_OK(
+        init_task_struct(idle_task, 0, "(idle)", 0, 0, NULL, NULL, 0, NULL));
+    idle_task->continuation = NULL;//空闲任务在引导时的内核栈上运行
     IDLE_TASK = idle_task;
     CURRENT_TASK = IDLE_TASK;
+    for (int i = 0; i < TASK_PRIORITY_MAX; i++) {
+        list_init(&CPUVAR->runqueues[i]);
+    }
+
+    CPUVAR->runqueue_bitmap = 0;
+    CPUVAR->account_clock = arch_clock();
 }
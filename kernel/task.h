@@ -2,17 +2,44 @@
 #include "arch.h"
 #include "hinavm.h"
 #include "interrupt.h"
+#include "timer.h"
 #include <libs/common/list.h>
 #include <libs/common/message.h>
 #include <libs/common/types.h>
 
+// 一个tick的微秒数
+#define TICK_US (1000000 / TICK_HZ)
 // 任务的最大连续执行时间
 #define TASK_QUANTUM (20 * (TICK_HZ / 1000))/*20毫秒*/
+// 预留CPU时间（预算）还有剩余的任务使用的优先级
+#define TASK_PRIORITY_RESERVED 0
+// 预留CPU时间的最大周期
+#define TASK_RESERVATION_PERIOD_MAX (1000 * (TICK_HZ / 1000))/*1秒*/
 // 当前CPU空闲任务（struct task *）
 #define IDLE_TASK (arch_cpuvar_get()->idle_task)
 // 正在运行的任务（结构任务*）
 #define CURRENT_TASK (arch_cpuvar_get()->current_task)
 
+// 每个任务的内核邮箱可以存放的异步消息数
+#define TASK_MAILBOX_LEN 8
+// 内核邮箱的大小（字节）
+#define TASK_MAILBOX_SIZE                                                      \
+    ALIGN_UP(sizeof(struct message) * TASK_MAILBOX_LEN, PAGE_SIZE)
+
+// 一次分配的任务管理结构的数量
+#define TASK_TABLE_CHUNK 8
+STATIC_ASSERT(NUM_TASKS_MAX <= TASK_INDEX_MASK, "too many tasks for tid");
+
+// 记录异步通知发送方的位图的字数（每个任务表的索引一位）
+#define ASYNC_PENDING_WORDS (ALIGN_UP(NUM_TASKS_MAX, 32) / 32)
+STATIC_ASSERT(ASYNC_PENDING_WORDS <= 32, "too many tasks for async_summary");
+
+// 续体：不保留内核栈而阻塞的任务恢复后，在新的内核栈上执行的函数。调用方的栈帧在
+// 阻塞时全部被丢弃，因此续体需要的状态保存在任务管理结构中。不会返回。
+typedef __noreturn void (*continuation_t)(void);
+// 以续体恢复的IPC结束后执行的处理（err为IPC的结果）。不会返回。
+typedef __noreturn void (*ipc_done_t)(error_t err);
+
 // 任务状态
 #define TASK_UNUSED   0
 #define TASK_RUNNABLE 1
@@ -21,35 +48,94 @@
 // 任务管理结构
 struct task {
     struct arch_task arch;          // 依赖于CPU的任务信息
-    struct arch_vm vm;              // 页表
+    struct arch_vm vm;              // 页表（线程使用 process 的页表）
     task_t tid;                     // 任务ID
     char name[TASK_NAME_LEN];       // 任务名称
     int state;                      // 任务状态
+    continuation_t continuation;    // 不保留内核栈而阻塞时，恢复后执行的函数
     bool destroyed;                 // 任务是否正在被删除？
+    int cpu;                        // 最后执行（或所在运行队列）的CPU（-1表示没有）
+    int priority;                   // 实际使用的优先级（0为最高）
+    int base_priority;              // 通过task_set_priority设置的优先级
+    unsigned affinity;              // CPU亲和性（可以执行该任务的CPU的位图）
     struct task *pager;             // 寻呼机任务
-    unsigned timeout;               // 剩余超时时间
+    struct task *process;           // 共享地址空间的任务（主线程）。不是线程时指向自身
+    list_t threads;                 // 该任务的线程列表（仅主线程）
+    list_elem_t thread_next;        // 线程列表的元素
+    struct timer timers[TASK_TIMERS_MAX];  // 定时器（到期时发送NOTIFY_TIMER通知）
+    uint32_t timers_fired;          // 已到期但还没有通知的定时器的位图
+    struct timer ipc_timer;         // IPC超时用的定时器
+    unsigned rsv_budget;            // 每个周期预留的CPU时间（0表示没有预留）
+    unsigned rsv_period;            // 预留CPU时间的周期
+    unsigned rsv_remaining;         // 本周期剩余的预留CPU时间
+    struct timer rsv_timer;         // 每个周期补充预留CPU时间的定时器
+    uint64_t woken_at;              // 被唤醒的时刻（arch_clock，0表示没有在等待执行）
+    struct task_stats stats;        // 调度统计信息（name、priority、cpu除外）
+    bool ipc_expired;               // IPC已经超时
+    bool ipc_cancelable;            // 正在IPC中等待，可以因超时而中断
+    bool ipc_canceled;              // IPC的等待因超时而被中断
+    struct task *cont_dst;          // 续体使用：等待发送的目标任务
+    task_t cont_src;                // 续体使用：发送后接收的来源
+    __user struct message *cont_m;  // 续体使用：IPC的消息缓冲区
+    unsigned cont_flags;            // 续体使用：IPC的标志
+    ipc_done_t cont_done;           // 续体使用：IPC结束后执行的处理
     int ref_count;                  // 任务被引用的次数（不为零则无法删除）
     unsigned quantum;               // 任务剩余量
+    unsigned charge_us;             // 还没有从剩余量中扣除的不满一个tick的执行时间（微秒）
+    task_t donor;                   // 借给该任务CPU时间的调用方（0表示没有）
     list_elem_t waitqueue_next;     // 指向每个等待列表中下一个元素的指针
     list_elem_t next;               // 指向完整任务列表中下一个元素的指针
     list_t senders;                 // 等待发送到该任务的任务列表
+    struct task *service;           // 作为工作任务所属的服务（代表任务）
+    list_t workers;                 // 该服务的工作任务列表
+    list_elem_t worker_next;        // 指向工作任务列表中下一个元素的指针
     task_t wait_for;                // 可以向该任务发送消息的任务ID
                                     // （全部针对IPC_ANY）
-    list_t pages;                   // 正在使用的内存页列表
+    bool ipc_open_recv;             // 正在开放接收（非内核），可以直接接收异步消息
+    list_t pages;                   // 正在使用的内存页列表（线程使用 process 的）
+    uaddr_t ool_window;             // 接收out-of-line缓冲区的地址
+    size_t ool_window_size;         // 接收窗口的大小（0表示不接收）
     notifications_t notifications;  // 收到通知
+    // 发送了异步通知的任务的位图（第 TASK_INDEX(tid) - 1 位）
+    uint32_t async_pending[ASYNC_PENDING_WORDS];
+    // async_pending中非零的字的位图（第i位对应async_pending[i]）
+    uint32_t async_summary;
     struct message m;               // 消息临时存储区
+    struct message *ipc_buffer;     // 登记的消息缓冲区（内核可直接访问的地址）
+    uaddr_t ipc_buffer_uaddr;       // 消息缓冲区的用户地址
+    paddr_t ipc_buffer_paddr;       // 消息缓冲区所在的页面（已固定）
+    bool ipc_buffer_recv;           // 正在用消息缓冲区等待接收消息
+    bool ipc_buffer_filled;         // 发送方已将消息直接写入消息缓冲区
+    struct message *mailbox;        // 异步消息的内核邮箱（环形缓冲区，NULL表示未分配）
+    paddr_t mailbox_paddr;          // 内核邮箱的物理地址
+    unsigned mailbox_head;          // 邮箱中最早的消息的位置
+    unsigned mailbox_len;           // 邮箱中的消息数
 };
 
 extern list_t active_tasks;
 
 struct task *task_find(task_t tid);
+struct task *task_find_by_index(unsigned index);
 task_t task_create(const char *name, uaddr_t ip, struct task *pager);
+task_t thread_create(struct task *process, uaddr_t ip, uaddr_t sp,
+                     uaddr_t arg);
 task_t hinavm_create(const char *name, hinavm_inst_t *insts, uint32_t num_insts,
                      struct task *pager);
 error_t task_destroy(struct task *task);
 __noreturn void task_exit(int exception);
 void task_resume(struct task *task);
+void task_handoff(struct task *task, unsigned quantum);
+void task_lend(struct task *task, struct task *lender);
+void task_set_priority(struct task *task, int priority);
+void task_set_affinity(struct task *task, unsigned affinity);
+void task_set_reservation(struct task *task, unsigned budget, unsigned period);
+bool task_account(void);
+void task_get_stats(struct task *task, struct task_stats *stats);
+void task_preempt(void);
+bool task_contended(void);
+error_t task_join_service(struct task *leader, struct task *worker);
 void task_block(struct task *task);
 void task_switch(void);
+__noreturn void task_switch_continue(continuation_t continuation);
 void task_dump(void);
 void task_init_percpu(void);
@@ -0,0 +1,213 @@
+// 分层时间轮：插入和取消定时器都是 O(1)，到期处理平均也是 O(1)。
+//
+// 第 L 层的每个槽覆盖 2^(6*L) tick。到期时刻离当前时刻越远，定时器就放在越高的层。
+// 时间轮的当前时刻经过第 L 层的槽的边界时，该槽中的定时器被重新插入到更低的层
+// （级联），最终在第0层的槽中到期。
+#include "timer.h"
+#include "arch.h"
+#include "task.h"
+#include <libs/common/print.h>
+
+static list_t wheel[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS];//时间轮的槽
+static uint64_t wheel_bitmap[TIMER_WHEEL_LEVELS];//非空槽的位图（每层一个）
+static unsigned wheel_now;//时间轮已经处理到的时刻
+static unsigned num_timers;//时间轮中的定时器数
+
+//如果时刻 a 等于或晚于时刻 b，则返回 true。考虑到计数器的回绕。
+static bool time_after_eq(unsigned a, unsigned b) {
+    return (int) (a - b) >= 0;
+}
+
+//第 level 层的一个槽覆盖的时间的位数
+static unsigned level_shift(int level) {
+    return level * TIMER_WHEEL_BITS;
+}
+
+//根据与时间轮当前时刻的差，将定时器放入合适的层的槽中。
+static void wheel_insert(struct timer *timer) {
+    unsigned expires = timer->expires;
+    if (!time_after_eq(expires, wheel_now)) {
+        //已经过了到期时刻：在下一次处理时到期
+        expires = wheel_now + 1;
+    }
+
+    unsigned delta = expires - wheel_now;
+    int level = 0;
+    while (level < TIMER_WHEEL_LEVELS - 1
+           && delta >= (1u << level_shift(level + 1))) {
+        level++;
+    }
+
+    if (level == TIMER_WHEEL_LEVELS - 1
+        && delta >= (1u << level_shift(TIMER_WHEEL_LEVELS)) - 1) {
+        //太远了：先放到最上层最远的槽中，到时候再重新插入
+        expires = wheel_now + (1u << level_shift(TIMER_WHEEL_LEVELS)) - 1;
+    }
+
+    unsigned slot = (expires >> level_shift(level)) & (TIMER_WHEEL_SLOTS - 1);
+    timer->level = level;
+    timer->slot = slot;
+    list_push_back(&wheel[level][slot], &timer->next);
+    wheel_bitmap[level] |= 1ull << slot;
+}
+
+//将定时器从时间轮中删除。
+static void wheel_remove(struct timer *timer) {
+    list_remove(&timer->next);
+    if (list_is_empty(&wheel[timer->level][timer->slot])) {
+        wheel_bitmap[timer->level] &= ~(1ull << timer->slot);
+    }
+}
+
+//返回时间轮下一次需要处理的时刻：第0层中最近的槽的到期时刻，或者更高层中最近的
+//非空槽的级联时刻。时间轮为空时返回 0。
+static unsigned next_event(void) {
+    unsigned next = 0;
+    for (int level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+        uint64_t bitmap = wheel_bitmap[level];
+        if (!bitmap) {
+            continue;
+        }
+
+        //从当前位置的下一个槽开始寻找第一个非空槽
+        unsigned shift = level_shift(level);
+        unsigned start = ((wheel_now >> shift) + 1) & (TIMER_WHEEL_SLOTS - 1);
+        uint64_t rotated =
+            start ? (bitmap >> start) | (bitmap << (TIMER_WHEEL_SLOTS - start))
+                  : bitmap;
+        unsigned ahead = __builtin_ctzll(rotated) + 1;
+        unsigned time = ((wheel_now >> shift) + ahead) << shift;
+        if (!next || time_after_eq(next, time)) {
+            next = time;
+        }
+    }
+
+    return next;
+}
+
+//时间轮的当前时刻前进到 now 时的处理：级联经过了边界的高层的槽，然后使第0层的槽
+//中的定时器到期。
+static void process_slots(unsigned now) {
+    for (int level = TIMER_WHEEL_LEVELS - 1; level > 0; level--) {
+        unsigned shift = level_shift(level);
+        if (now & ((1u << shift) - 1)) {
+            //没有经过该层的槽的边界
+            continue;
+        }
+
+        unsigned slot = (now >> shift) & (TIMER_WHEEL_SLOTS - 1);
+        list_t *list = &wheel[level][slot];
+        wheel_bitmap[level] &= ~(1ull << slot);
+        struct timer *timer;
+        while ((timer = LIST_POP_FRONT(list, struct timer, next)) != NULL) {
+            wheel_insert(timer);
+        }
+    }
+
+    unsigned slot = now & (TIMER_WHEEL_SLOTS - 1);
+    list_t *list = &wheel[0][slot];
+    wheel_bitmap[0] &= ~(1ull << slot);
+    struct timer *timer;
+    while ((timer = LIST_POP_FRONT(list, struct timer, next)) != NULL) {
+        timer->active = false;
+        num_timers--;
+        timer->handler(timer);
+    }
+}
+
+//初始化定时器。handler 是到期时调用的函数。
+void timer_init(struct timer *timer, struct task *task, int id,
+                timer_handler_t handler) {
+    list_elem_init(&timer->next);
+    timer->active = false;
+    timer->handler = handler;
+    timer->task = task;
+    timer->id = id;
+}
+
+//启动定时器，在 ms 毫秒后到期。如果定时器已经在运行，则重新设置到期时刻。
+void timer_start(struct timer *timer, unsigned ms) {
+    if (!num_timers) {
+        //时间轮为空：不需要逐个处理已经过去的时刻
+        wheel_now = arch_uptime();
+    }
+
+    timer_cancel(timer);
+    //至少等待1 tick，使定时器不会被放入时间轮当前已经处理过的槽中
+    timer->expires = arch_uptime() + MAX(ms * (TICK_HZ / 1000), 1u);
+    timer->active = true;
+    num_timers++;
+    wheel_insert(timer);
+}
+
+//取消定时器。如果定时器没有在运行，则什么也不做。
+void timer_cancel(struct timer *timer) {
+    if (!timer->active) {
+        return;
+    }
+
+    wheel_remove(timer);
+    timer->active = false;
+    num_timers--;
+}
+
+//将时间轮的当前时刻推进到现在，处理到期的定时器。只处理有非空槽的时刻，因此长时间
+//没有定时器中断之后也不需要逐个tick地处理。
+void timer_advance(void) {
+    unsigned now = arch_uptime();
+    while (!time_after_eq(wheel_now, now)) {
+        unsigned next = num_timers ? next_event() : 0;
+        if (!next || !time_after_eq(now, next)) {
+            //到现在为止没有需要处理的槽
+            wheel_now = now;
+            break;
+        }
+
+        wheel_now = next;
+        process_slots(next);
+    }
+}
+
+//返回 deadline 和 now + ticks 中较早的时刻。deadline 为零表示没有。
+static unsigned earlier_deadline(unsigned deadline, unsigned now,
+                                 unsigned ticks) {
+    unsigned end = now + ticks;
+    if (!deadline || time_after_eq(deadline, end)) {
+        return end ? end : 1;
+    }
+
+    return deadline;
+}
+
+//设置当前CPU的下一次定时器中断：时间轮下一次需要处理的时刻，以及如果有其他任务在
+//等待CPU，则还有正在运行的任务的时间片用完的时刻。不再以固定周期产生定时器中断，
+//没有事件需要处理的CPU（例如空闲的CPU）不会被定时器中断唤醒。在返回用户模式或进入
+//空闲状态之前调用。
+//
+//正在使用预留CPU时间的任务即使没有其他任务在等待，也要在预留CPU时间用完的时刻产生
+//定时器中断，以便降低它的优先级。
+void timer_reprogram(void) {
+    unsigned deadline = num_timers ? next_event() : 0;
+    unsigned now = arch_uptime();
+    struct task *current = CURRENT_TASK;
+    if (current != IDLE_TASK && task_contended()) {
+        deadline = earlier_deadline(deadline, now, current->quantum);
+    }
+
+    if (current->rsv_budget && current->rsv_remaining) {
+        deadline = earlier_deadline(deadline, now, current->rsv_remaining);
+    }
+
+    arch_timer_set(deadline);
+}
+
+//初始化时间轮。
+void timer_init_wheel(void) {
+    for (int level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+        for (int slot = 0; slot < TIMER_WHEEL_SLOTS; slot++) {
+            list_init(&wheel[level][slot]);
+        }
+
+        wheel_bitmap[level] = 0;
+    }
+}
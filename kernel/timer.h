@@ -0,0 +1,35 @@
+#pragma once
+#include <libs/common/list.h>
+#include <libs/common/types.h>
+
+// 时间轮每一层的槽数（2的幂）的位数
+#define TIMER_WHEEL_BITS 6
+// 时间轮每一层的槽数
+#define TIMER_WHEEL_SLOTS (1 << TIMER_WHEEL_BITS)
+// 时间轮的层数。可以直接放入时间轮的最大时间为 2^(6*4) tick（约4.6小时），更长的
+// 定时器先放在最上层，之后重新插入。
+#define TIMER_WHEEL_LEVELS 4
+
+struct task;
+struct timer;
+typedef void (*timer_handler_t)(struct timer *timer);
+
+// 定时器
+struct timer {
+    list_elem_t next;         // 时间轮的槽中的下一个定时器
+    unsigned expires;         // 到期时刻（自启动以来经过的tick数）
+    bool active;              // 是否在时间轮中
+    uint8_t level;            // 所在的层
+    uint8_t slot;             // 所在的槽
+    timer_handler_t handler;  // 到期时调用的函数
+    struct task *task;        // 定时器所属的任务
+    int id;                   // 定时器ID（每个任务内唯一）
+};
+
+void timer_init_wheel(void);
+void timer_init(struct timer *timer, struct task *task, int id,
+                timer_handler_t handler);
+void timer_start(struct timer *timer, unsigned ms);
+void timer_cancel(struct timer *timer);
+void timer_advance(void);
+void timer_reprogram(void);
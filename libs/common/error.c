@@ -31,6 +31,7 @@ static const char *error_names[] = {
     [-ERR_NOT_A_FILE] = "Not A File",
     [-ERR_NOT_A_DIR] = "Not A Directory",
     [-ERR_EOF] = "End of File",
+    [-ERR_TIMEOUT] = "Timed Out",
 };
 
 // エラー番号からエラーメッセージを取得する。
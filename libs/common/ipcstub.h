@@ -27,12 +27,15 @@ struct page_fault_reply_fields {
 
 struct notify_fields {
     notifications_t notifications;
+    task_t async_src;
+    uint32_t timers;
 };
 
 struct notify_irq_fields {
 };
 
 struct notify_timer_fields {
+    int timer_id;
 };
 
 struct async_recv_fields {
@@ -40,6 +43,10 @@ struct async_recv_fields {
 struct async_recv_reply_fields {
 };
 
+struct channel_ready_fields {
+    task_t producer;
+};
+
 struct ping_fields {
     int value;
 };
@@ -54,6 +61,15 @@ struct spawn_task_reply_fields {
     task_t task;
 };
 
+struct spawn_thread_fields {
+    uaddr_t ip;
+    uaddr_t sp;
+    uaddr_t arg;
+};
+struct spawn_thread_reply_fields {
+    task_t thread;
+};
+
 struct destroy_task_fields {
     task_t task;
 };
@@ -101,39 +117,50 @@ struct vm_alloc_physical_reply_fields {
     paddr_t paddr;
 };
 
+struct vm_alloc_shared_fields {
+    task_t peer;
+    size_t size;
+};
+struct vm_alloc_shared_reply_fields {
+    uaddr_t uaddr;
+    uaddr_t peer_uaddr;
+};
+
 struct blk_read_fields {
     unsigned sector;
     size_t offset;
     size_t len;
 };
 struct blk_read_reply_fields {
-    uint8_t data[1024];
     size_t data_len;
+    uint8_t data[1024];
 };
 
 struct blk_write_fields {
     unsigned sector;
     size_t offset;
-    uint8_t data[1024];
     size_t data_len;
+    uint8_t data[1024];
 };
 struct blk_write_reply_fields {
 };
 
 struct net_open_fields {
+    uaddr_t tx_channel;
 };
 struct net_open_reply_fields {
     uint8_t macaddr[6];
+    uaddr_t rx_channel;
 };
 
 struct net_recv_fields {
-    uint8_t payload[1500];
     size_t payload_len;
+    uint8_t payload[1500];
 };
 
 struct net_send_fields {
-    uint8_t payload[1500];
     size_t payload_len;
+    uint8_t payload[1500];
 };
 struct net_send_reply_fields {
 };
@@ -157,14 +184,23 @@ struct fs_read_fields {
     size_t len;
 };
 struct fs_read_reply_fields {
+    size_t data_len;
     uint8_t data[1024];
+};
+
+struct fs_read_pages_fields {
+    int fd;
+    size_t len;
+};
+struct fs_read_pages_reply_fields {
+    uaddr_t data;
     size_t data_len;
 };
 
 struct fs_write_fields {
     int fd;
-    uint8_t data[1024];
     size_t data_len;
+    uint8_t data[1024];
 };
 struct fs_write_reply_fields {
     size_t written_len;
@@ -214,8 +250,8 @@ struct tcpip_close_reply_fields {
 
 struct tcpip_write_fields {
     int sock;
-    uint8_t data[1024];
     size_t data_len;
+    uint8_t data[1024];
 };
 struct tcpip_write_reply_fields {
 };
@@ -224,8 +260,8 @@ struct tcpip_read_fields {
     int sock;
 };
 struct tcpip_read_reply_fields {
-    uint8_t data[1024];
     size_t data_len;
+    uint8_t data[1024];
 };
 
 struct tcpip_dns_resolve_fields {
@@ -253,60 +289,67 @@ struct tcpip_closed_fields {
 #define NOTIFY_TIMER_MSG 6
 #define ASYNC_RECV_MSG 7
 #define ASYNC_RECV_REPLY_MSG 8
-#define PING_MSG 9
-#define PING_REPLY_MSG 10
-#define SPAWN_TASK_MSG 11
-#define SPAWN_TASK_REPLY_MSG 12
-#define DESTROY_TASK_MSG 13
-#define DESTROY_TASK_REPLY_MSG 14
-#define SERVICE_LOOKUP_MSG 15
-#define SERVICE_LOOKUP_REPLY_MSG 16
-#define SERVICE_REGISTER_MSG 17
-#define SERVICE_REGISTER_REPLY_MSG 18
-#define WATCH_TASKS_MSG 19
-#define WATCH_TASKS_REPLY_MSG 20
-#define TASK_DESTROYED_MSG 21
-#define VM_MAP_PHYSICAL_MSG 22
-#define VM_MAP_PHYSICAL_REPLY_MSG 23
-#define VM_ALLOC_PHYSICAL_MSG 24
-#define VM_ALLOC_PHYSICAL_REPLY_MSG 25
-#define BLK_READ_MSG 26
-#define BLK_READ_REPLY_MSG 27
-#define BLK_WRITE_MSG 28
-#define BLK_WRITE_REPLY_MSG 29
-#define NET_OPEN_MSG 30
-#define NET_OPEN_REPLY_MSG 31
-#define NET_RECV_MSG 32
-#define NET_SEND_MSG 33
-#define NET_SEND_REPLY_MSG 34
-#define FS_OPEN_MSG 35
-#define FS_OPEN_REPLY_MSG 36
-#define FS_CLOSE_MSG 37
-#define FS_CLOSE_REPLY_MSG 38
-#define FS_READ_MSG 39
-#define FS_READ_REPLY_MSG 40
-#define FS_WRITE_MSG 41
-#define FS_WRITE_REPLY_MSG 42
-#define FS_READDIR_MSG 43
-#define FS_READDIR_REPLY_MSG 44
-#define FS_MKFILE_MSG 45
-#define FS_MKFILE_REPLY_MSG 46
-#define FS_MKDIR_MSG 47
-#define FS_MKDIR_REPLY_MSG 48
-#define FS_DELETE_MSG 49
-#define FS_DELETE_REPLY_MSG 50
-#define TCPIP_CONNECT_MSG 51
-#define TCPIP_CONNECT_REPLY_MSG 52
-#define TCPIP_CLOSE_MSG 53
-#define TCPIP_CLOSE_REPLY_MSG 54
-#define TCPIP_WRITE_MSG 55
-#define TCPIP_WRITE_REPLY_MSG 56
-#define TCPIP_READ_MSG 57
-#define TCPIP_READ_REPLY_MSG 58
-#define TCPIP_DNS_RESOLVE_MSG 59
-#define TCPIP_DNS_RESOLVE_REPLY_MSG 60
-#define TCPIP_DATA_MSG 61
-#define TCPIP_CLOSED_MSG 62
+#define CHANNEL_READY_MSG 9
+#define PING_MSG 10
+#define PING_REPLY_MSG 11
+#define SPAWN_TASK_MSG 12
+#define SPAWN_TASK_REPLY_MSG 13
+#define SPAWN_THREAD_MSG 14
+#define SPAWN_THREAD_REPLY_MSG 15
+#define DESTROY_TASK_MSG 16
+#define DESTROY_TASK_REPLY_MSG 17
+#define SERVICE_LOOKUP_MSG 18
+#define SERVICE_LOOKUP_REPLY_MSG 19
+#define SERVICE_REGISTER_MSG 20
+#define SERVICE_REGISTER_REPLY_MSG 21
+#define WATCH_TASKS_MSG 22
+#define WATCH_TASKS_REPLY_MSG 23
+#define TASK_DESTROYED_MSG 24
+#define VM_MAP_PHYSICAL_MSG 25
+#define VM_MAP_PHYSICAL_REPLY_MSG 26
+#define VM_ALLOC_PHYSICAL_MSG 27
+#define VM_ALLOC_PHYSICAL_REPLY_MSG 28
+#define VM_ALLOC_SHARED_MSG 29
+#define VM_ALLOC_SHARED_REPLY_MSG 30
+#define BLK_READ_MSG 31
+#define BLK_READ_REPLY_MSG 32
+#define BLK_WRITE_MSG 33
+#define BLK_WRITE_REPLY_MSG 34
+#define NET_OPEN_MSG 35
+#define NET_OPEN_REPLY_MSG 36
+#define NET_RECV_MSG 37
+#define NET_SEND_MSG 38
+#define NET_SEND_REPLY_MSG 39
+#define FS_OPEN_MSG 40
+#define FS_OPEN_REPLY_MSG 41
+#define FS_CLOSE_MSG 42
+#define FS_CLOSE_REPLY_MSG 43
+#define FS_READ_MSG 44
+#define FS_READ_REPLY_MSG 45
+#define FS_READ_PAGES_MSG 46
+#define FS_READ_PAGES_REPLY_MSG 47
+#define FS_WRITE_MSG 48
+#define FS_WRITE_REPLY_MSG 49
+#define FS_READDIR_MSG 50
+#define FS_READDIR_REPLY_MSG 51
+#define FS_MKFILE_MSG 52
+#define FS_MKFILE_REPLY_MSG 53
+#define FS_MKDIR_MSG 54
+#define FS_MKDIR_REPLY_MSG 55
+#define FS_DELETE_MSG 56
+#define FS_DELETE_REPLY_MSG 57
+#define TCPIP_CONNECT_MSG 58
+#define TCPIP_CONNECT_REPLY_MSG 59
+#define TCPIP_CLOSE_MSG 60
+#define TCPIP_CLOSE_REPLY_MSG 61
+#define TCPIP_WRITE_MSG 62
+#define TCPIP_WRITE_REPLY_MSG 63
+#define TCPIP_READ_MSG 64
+#define TCPIP_READ_REPLY_MSG 65
+#define TCPIP_DNS_RESOLVE_MSG 66
+#define TCPIP_DNS_RESOLVE_REPLY_MSG 67
+#define TCPIP_DATA_MSG 68
+#define TCPIP_CLOSED_MSG 69
 
 //
 //  各種マクロの定義
@@ -320,10 +363,13 @@ struct tcpip_closed_fields {
     struct notify_timer_fields notify_timer; \
     struct async_recv_fields async_recv; \
     struct async_recv_reply_fields async_recv_reply; \
+    struct channel_ready_fields channel_ready; \
     struct ping_fields ping; \
     struct ping_reply_fields ping_reply; \
     struct spawn_task_fields spawn_task; \
     struct spawn_task_reply_fields spawn_task_reply; \
+    struct spawn_thread_fields spawn_thread; \
+    struct spawn_thread_reply_fields spawn_thread_reply; \
     struct destroy_task_fields destroy_task; \
     struct destroy_task_reply_fields destroy_task_reply; \
     struct service_lookup_fields service_lookup; \
@@ -337,6 +383,8 @@ struct tcpip_closed_fields {
     struct vm_map_physical_reply_fields vm_map_physical_reply; \
     struct vm_alloc_physical_fields vm_alloc_physical; \
     struct vm_alloc_physical_reply_fields vm_alloc_physical_reply; \
+    struct vm_alloc_shared_fields vm_alloc_shared; \
+    struct vm_alloc_shared_reply_fields vm_alloc_shared_reply; \
     struct blk_read_fields blk_read; \
     struct blk_read_reply_fields blk_read_reply; \
     struct blk_write_fields blk_write; \
@@ -352,6 +400,8 @@ struct tcpip_closed_fields {
     struct fs_close_reply_fields fs_close_reply; \
     struct fs_read_fields fs_read; \
     struct fs_read_reply_fields fs_read_reply; \
+    struct fs_read_pages_fields fs_read_pages; \
+    struct fs_read_pages_reply_fields fs_read_pages_reply; \
     struct fs_write_fields fs_write; \
     struct fs_write_reply_fields fs_write_reply; \
     struct fs_readdir_fields fs_readdir; \
@@ -375,7 +425,7 @@ struct tcpip_closed_fields {
     struct tcpip_data_fields tcpip_data; \
     struct tcpip_closed_fields tcpip_closed; \
 
-#define IPCSTUB_MSGID_MAX 62
+#define IPCSTUB_MSGID_MAX 69
 #define IPCSTUB_MSGID2STR \
     (const char *[]){ \
      \
@@ -393,88 +443,212 @@ struct tcpip_closed_fields {
         [7] = "async_recv", \
         [8] = "async_recv_reply", \
      \
-        [9] = "ping", \
-        [10] = "ping_reply", \
+        [9] = "channel_ready", \
+     \
+        [10] = "ping", \
+        [11] = "ping_reply", \
+     \
+        [12] = "spawn_task", \
+        [13] = "spawn_task_reply", \
+     \
+        [14] = "spawn_thread", \
+        [15] = "spawn_thread_reply", \
+     \
+        [16] = "destroy_task", \
+        [17] = "destroy_task_reply", \
      \
-        [11] = "spawn_task", \
-        [12] = "spawn_task_reply", \
+        [18] = "service_lookup", \
+        [19] = "service_lookup_reply", \
      \
-        [13] = "destroy_task", \
-        [14] = "destroy_task_reply", \
+        [20] = "service_register", \
+        [21] = "service_register_reply", \
      \
-        [15] = "service_lookup", \
-        [16] = "service_lookup_reply", \
+        [22] = "watch_tasks", \
+        [23] = "watch_tasks_reply", \
      \
-        [17] = "service_register", \
-        [18] = "service_register_reply", \
+        [24] = "task_destroyed", \
      \
-        [19] = "watch_tasks", \
-        [20] = "watch_tasks_reply", \
+        [25] = "vm_map_physical", \
+        [26] = "vm_map_physical_reply", \
      \
-        [21] = "task_destroyed", \
+        [27] = "vm_alloc_physical", \
+        [28] = "vm_alloc_physical_reply", \
      \
-        [22] = "vm_map_physical", \
-        [23] = "vm_map_physical_reply", \
+        [29] = "vm_alloc_shared", \
+        [30] = "vm_alloc_shared_reply", \
      \
-        [24] = "vm_alloc_physical", \
-        [25] = "vm_alloc_physical_reply", \
+        [31] = "blk_read", \
+        [32] = "blk_read_reply", \
      \
-        [26] = "blk_read", \
-        [27] = "blk_read_reply", \
+        [33] = "blk_write", \
+        [34] = "blk_write_reply", \
      \
-        [28] = "blk_write", \
-        [29] = "blk_write_reply", \
+        [35] = "net_open", \
+        [36] = "net_open_reply", \
      \
-        [30] = "net_open", \
-        [31] = "net_open_reply", \
+        [37] = "net_recv", \
      \
-        [32] = "net_recv", \
+        [38] = "net_send", \
+        [39] = "net_send_reply", \
      \
-        [33] = "net_send", \
-        [34] = "net_send_reply", \
+        [40] = "fs_open", \
+        [41] = "fs_open_reply", \
      \
-        [35] = "fs_open", \
-        [36] = "fs_open_reply", \
+        [42] = "fs_close", \
+        [43] = "fs_close_reply", \
      \
-        [37] = "fs_close", \
-        [38] = "fs_close_reply", \
+        [44] = "fs_read", \
+        [45] = "fs_read_reply", \
      \
-        [39] = "fs_read", \
-        [40] = "fs_read_reply", \
+        [46] = "fs_read_pages", \
+        [47] = "fs_read_pages_reply", \
      \
-        [41] = "fs_write", \
-        [42] = "fs_write_reply", \
+        [48] = "fs_write", \
+        [49] = "fs_write_reply", \
      \
-        [43] = "fs_readdir", \
-        [44] = "fs_readdir_reply", \
+        [50] = "fs_readdir", \
+        [51] = "fs_readdir_reply", \
      \
-        [45] = "fs_mkfile", \
-        [46] = "fs_mkfile_reply", \
+        [52] = "fs_mkfile", \
+        [53] = "fs_mkfile_reply", \
      \
-        [47] = "fs_mkdir", \
-        [48] = "fs_mkdir_reply", \
+        [54] = "fs_mkdir", \
+        [55] = "fs_mkdir_reply", \
      \
-        [49] = "fs_delete", \
-        [50] = "fs_delete_reply", \
+        [56] = "fs_delete", \
+        [57] = "fs_delete_reply", \
      \
-        [51] = "tcpip_connect", \
-        [52] = "tcpip_connect_reply", \
+        [58] = "tcpip_connect", \
+        [59] = "tcpip_connect_reply", \
      \
-        [53] = "tcpip_close", \
-        [54] = "tcpip_close_reply", \
+        [60] = "tcpip_close", \
+        [61] = "tcpip_close_reply", \
      \
-        [55] = "tcpip_write", \
-        [56] = "tcpip_write_reply", \
+        [62] = "tcpip_write", \
+        [63] = "tcpip_write_reply", \
      \
-        [57] = "tcpip_read", \
-        [58] = "tcpip_read_reply", \
+        [64] = "tcpip_read", \
+        [65] = "tcpip_read_reply", \
      \
-        [59] = "tcpip_dns_resolve", \
-        [60] = "tcpip_dns_resolve_reply", \
+        [66] = "tcpip_dns_resolve", \
+        [67] = "tcpip_dns_resolve_reply", \
      \
-        [61] = "tcpip_data", \
+        [68] = "tcpip_data", \
      \
-        [62] = "tcpip_closed", \
+        [69] = "tcpip_closed", \
+     \
+    }
+
+#define IPCSTUB_MSG_LAYOUTS \
+    { \
+     \
+        [1] = { .fixed_len = sizeof(struct exception_fields) }, \
+     \
+        [2] = { .fixed_len = sizeof(struct page_fault_fields) }, \
+        [3] = { .fixed_len = sizeof(struct page_fault_reply_fields) }, \
+     \
+        [4] = { .fixed_len = sizeof(struct notify_fields) }, \
+     \
+        [5] = { .fixed_len = sizeof(struct notify_irq_fields) }, \
+     \
+        [6] = { .fixed_len = sizeof(struct notify_timer_fields) }, \
+     \
+        [7] = { .fixed_len = sizeof(struct async_recv_fields) }, \
+        [8] = { .any = true }, \
+     \
+        [9] = { .fixed_len = sizeof(struct channel_ready_fields) }, \
+     \
+        [10] = { .fixed_len = sizeof(struct ping_fields) }, \
+        [11] = { .fixed_len = sizeof(struct ping_reply_fields) }, \
+     \
+        [12] = { .fixed_len = sizeof(struct spawn_task_fields) }, \
+        [13] = { .fixed_len = sizeof(struct spawn_task_reply_fields) }, \
+     \
+        [14] = { .fixed_len = sizeof(struct spawn_thread_fields) }, \
+        [15] = { .fixed_len = sizeof(struct spawn_thread_reply_fields) }, \
+     \
+        [16] = { .fixed_len = sizeof(struct destroy_task_fields) }, \
+        [17] = { .fixed_len = sizeof(struct destroy_task_reply_fields) }, \
+     \
+        [18] = { .fixed_len = sizeof(struct service_lookup_fields) }, \
+        [19] = { .fixed_len = sizeof(struct service_lookup_reply_fields) }, \
+     \
+        [20] = { .fixed_len = sizeof(struct service_register_fields) }, \
+        [21] = { .fixed_len = sizeof(struct service_register_reply_fields) }, \
+     \
+        [22] = { .fixed_len = sizeof(struct watch_tasks_fields) }, \
+        [23] = { .fixed_len = sizeof(struct watch_tasks_reply_fields) }, \
+     \
+        [24] = { .fixed_len = sizeof(struct task_destroyed_fields) }, \
+     \
+        [25] = { .fixed_len = sizeof(struct vm_map_physical_fields) }, \
+        [26] = { .fixed_len = sizeof(struct vm_map_physical_reply_fields) }, \
+     \
+        [27] = { .fixed_len = sizeof(struct vm_alloc_physical_fields) }, \
+        [28] = { .fixed_len = sizeof(struct vm_alloc_physical_reply_fields) }, \
+     \
+        [29] = { .fixed_len = sizeof(struct vm_alloc_shared_fields) }, \
+        [30] = { .fixed_len = sizeof(struct vm_alloc_shared_reply_fields) }, \
+     \
+        [31] = { .fixed_len = sizeof(struct blk_read_fields) }, \
+        [32] = { .fixed_len = offsetof(struct blk_read_reply_fields, data), .len_offset = offsetof(struct blk_read_reply_fields, data_len), .max_var_len = 1024 }, \
+     \
+        [33] = { .fixed_len = offsetof(struct blk_write_fields, data), .len_offset = offsetof(struct blk_write_fields, data_len), .max_var_len = 1024 }, \
+        [34] = { .fixed_len = sizeof(struct blk_write_reply_fields) }, \
+     \
+        [35] = { .fixed_len = sizeof(struct net_open_fields) }, \
+        [36] = { .fixed_len = sizeof(struct net_open_reply_fields) }, \
+     \
+        [37] = { .fixed_len = offsetof(struct net_recv_fields, payload), .len_offset = offsetof(struct net_recv_fields, payload_len), .max_var_len = 1500 }, \
+     \
+        [38] = { .fixed_len = offsetof(struct net_send_fields, payload), .len_offset = offsetof(struct net_send_fields, payload_len), .max_var_len = 1500 }, \
+        [39] = { .fixed_len = sizeof(struct net_send_reply_fields) }, \
+     \
+        [40] = { .fixed_len = sizeof(struct fs_open_fields) }, \
+        [41] = { .fixed_len = sizeof(struct fs_open_reply_fields) }, \
+     \
+        [42] = { .fixed_len = sizeof(struct fs_close_fields) }, \
+        [43] = { .fixed_len = sizeof(struct fs_close_reply_fields) }, \
+     \
+        [44] = { .fixed_len = sizeof(struct fs_read_fields) }, \
+        [45] = { .fixed_len = offsetof(struct fs_read_reply_fields, data), .len_offset = offsetof(struct fs_read_reply_fields, data_len), .max_var_len = 1024 }, \
+     \
+        [46] = { .fixed_len = sizeof(struct fs_read_pages_fields) }, \
+        [47] = { .fixed_len = sizeof(struct fs_read_pages_reply_fields), .ool = true, .ool_offset = offsetof(struct fs_read_pages_reply_fields, data), .ool_len_offset = offsetof(struct fs_read_pages_reply_fields, data_len) }, \
+     \
+        [48] = { .fixed_len = offsetof(struct fs_write_fields, data), .len_offset = offsetof(struct fs_write_fields, data_len), .max_var_len = 1024 }, \
+        [49] = { .fixed_len = sizeof(struct fs_write_reply_fields) }, \
+     \
+        [50] = { .fixed_len = sizeof(struct fs_readdir_fields) }, \
+        [51] = { .fixed_len = sizeof(struct fs_readdir_reply_fields) }, \
+     \
+        [52] = { .fixed_len = sizeof(struct fs_mkfile_fields) }, \
+        [53] = { .fixed_len = sizeof(struct fs_mkfile_reply_fields) }, \
+     \
+        [54] = { .fixed_len = sizeof(struct fs_mkdir_fields) }, \
+        [55] = { .fixed_len = sizeof(struct fs_mkdir_reply_fields) }, \
+     \
+        [56] = { .fixed_len = sizeof(struct fs_delete_fields) }, \
+        [57] = { .fixed_len = sizeof(struct fs_delete_reply_fields) }, \
+     \
+        [58] = { .fixed_len = sizeof(struct tcpip_connect_fields) }, \
+        [59] = { .fixed_len = sizeof(struct tcpip_connect_reply_fields) }, \
+     \
+        [60] = { .fixed_len = sizeof(struct tcpip_close_fields) }, \
+        [61] = { .fixed_len = sizeof(struct tcpip_close_reply_fields) }, \
+     \
+        [62] = { .fixed_len = offsetof(struct tcpip_write_fields, data), .len_offset = offsetof(struct tcpip_write_fields, data_len), .max_var_len = 1024 }, \
+        [63] = { .fixed_len = sizeof(struct tcpip_write_reply_fields) }, \
+     \
+        [64] = { .fixed_len = sizeof(struct tcpip_read_fields) }, \
+        [65] = { .fixed_len = offsetof(struct tcpip_read_reply_fields, data), .len_offset = offsetof(struct tcpip_read_reply_fields, data_len), .max_var_len = 1024 }, \
+     \
+        [66] = { .fixed_len = sizeof(struct tcpip_dns_resolve_fields) }, \
+        [67] = { .fixed_len = sizeof(struct tcpip_dns_resolve_reply_fields) }, \
+     \
+        [68] = { .fixed_len = sizeof(struct tcpip_data_fields) }, \
+     \
+        [69] = { .fixed_len = sizeof(struct tcpip_closed_fields) }, \
      \
     }
 
@@ -511,6 +685,10 @@ struct tcpip_closed_fields {
         sizeof(struct async_recv_reply_fields) < 4096, \
         "'async_recv_reply' message is too large, should be less than 4096 bytes" \
     ); \
+    _Static_assert( \
+        sizeof(struct channel_ready_fields) < 4096, \
+        "'channel_ready' message is too large, should be less than 4096 bytes" \
+    ); \
     _Static_assert( \
         sizeof(struct ping_fields) < 4096, \
         "'ping' message is too large, should be less than 4096 bytes" \
@@ -527,6 +705,14 @@ struct tcpip_closed_fields {
         sizeof(struct spawn_task_reply_fields) < 4096, \
         "'spawn_task_reply' message is too large, should be less than 4096 bytes" \
     ); \
+    _Static_assert( \
+        sizeof(struct spawn_thread_fields) < 4096, \
+        "'spawn_thread' message is too large, should be less than 4096 bytes" \
+    ); \
+    _Static_assert( \
+        sizeof(struct spawn_thread_reply_fields) < 4096, \
+        "'spawn_thread_reply' message is too large, should be less than 4096 bytes" \
+    ); \
     _Static_assert( \
         sizeof(struct destroy_task_fields) < 4096, \
         "'destroy_task' message is too large, should be less than 4096 bytes" \
@@ -579,6 +765,14 @@ struct tcpip_closed_fields {
         sizeof(struct vm_alloc_physical_reply_fields) < 4096, \
         "'vm_alloc_physical_reply' message is too large, should be less than 4096 bytes" \
     ); \
+    _Static_assert( \
+        sizeof(struct vm_alloc_shared_fields) < 4096, \
+        "'vm_alloc_shared' message is too large, should be less than 4096 bytes" \
+    ); \
+    _Static_assert( \
+        sizeof(struct vm_alloc_shared_reply_fields) < 4096, \
+        "'vm_alloc_shared_reply' message is too large, should be less than 4096 bytes" \
+    ); \
     _Static_assert( \
         sizeof(struct blk_read_fields) < 4096, \
         "'blk_read' message is too large, should be less than 4096 bytes" \
@@ -639,6 +833,14 @@ struct tcpip_closed_fields {
         sizeof(struct fs_read_reply_fields) < 4096, \
         "'fs_read_reply' message is too large, should be less than 4096 bytes" \
     ); \
+    _Static_assert( \
+        sizeof(struct fs_read_pages_fields) < 4096, \
+        "'fs_read_pages' message is too large, should be less than 4096 bytes" \
+    ); \
+    _Static_assert( \
+        sizeof(struct fs_read_pages_reply_fields) < 4096, \
+        "'fs_read_pages_reply' message is too large, should be less than 4096 bytes" \
+    ); \
     _Static_assert( \
         sizeof(struct fs_write_fields) < 4096, \
         "'fs_write' message is too large, should be less than 4096 bytes" \
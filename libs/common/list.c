@@ -90,6 +90,13 @@ void list_push_back(list_t *list, list_elem_t *new_tail) {
     list_insert(list->prev, list, new_tail);
 }
 
+// エントリをリストの先頭に追加する。O(1)。
+void list_push_front(list_t *list, list_elem_t *new_head) {
+    DEBUG_ASSERT(!list_contains(list, new_head));
+    DEBUG_ASSERT(!list_is_linked(new_head));
+    list_insert(list, list->next, new_head);
+}
+
 // リストの先頭エントリを取り出す。空の場合はNULLを返す。O(1)。
 list_elem_t *list_pop_front(list_t *list) {
     struct list *head = list->next;
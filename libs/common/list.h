@@ -58,4 +58,5 @@ size_t list_len(list_t *list);
 bool list_contains(list_t *list, list_elem_t *elem);
 void list_remove(list_elem_t *elem);
 void list_push_back(list_t *list, list_elem_t *new_tail);
+void list_push_front(list_t *list, list_elem_t *new_head);
 list_elem_t *list_pop_front(list_t *list);
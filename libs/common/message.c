@@ -11,3 +11,65 @@ const char *msgtype2str(int type) {
 
     return IPCSTUB_MSGID2STR[type];
 }
+
+// メッセージの種類ごとのレイアウト情報
+static const struct message_layout msg_layouts[IPCSTUB_MSGID_MAX + 1] =
+    IPCSTUB_MSG_LAYOUTS;
+
+// メッセージの種類に対応するレイアウト情報を返す。未知の種類の場合はNULLを返す。
+static const struct message_layout *msg_layout(int type) {
+    if (type <= 0 || type > IPCSTUB_MSGID_MAX) {
+        return NULL;
+    }
+
+    const struct message_layout *layout = &msg_layouts[type];
+    return layout->any ? NULL : layout;
+}
+
+// ヘッダと固定長フィールドの大きさ (つまり可変長フィールドを除いたメッセージの大きさ)
+// を返す。可変長フィールドの実際の長さを知るには、まずこの大きさだけ読み込む必要がある。
+size_t msg_fixed_len(int type) {
+    if (type < 0) {
+        // エラーメッセージはヘッダのみ
+        return MESSAGE_HEADER_LEN;
+    }
+
+    const struct message_layout *layout = msg_layout(type);
+    if (!layout) {
+        // 未知の種類のメッセージはすべてコピーする
+        return sizeof(struct message);
+    }
+
+    return MESSAGE_HEADER_LEN + layout->fixed_len;
+}
+
+// メッセージの実際の長さ (ヘッダ + 固定長フィールド + 可変長フィールドの実際の長さ) を
+// 返す。メッセージのコピーはこの長さ分だけ行えばよい。
+size_t msg_len(const struct message *m) {
+    size_t len = msg_fixed_len(m->type);
+    const struct message_layout *layout = msg_layout(m->type);
+    if (layout && layout->max_var_len > 0) {
+        size_t var_len = *(size_t *) &m->data[layout->len_offset];
+        len += MIN(var_len, (size_t) layout->max_var_len);
+    }
+
+    return len;
+}
+
+// メッセージがレジスタIPC (ipc_fastシステムコール) で送れるほど小さいかを返す。
+bool msg_fits_fast(const struct message *m) {
+    return msg_len(m) <= IPC_FAST_MAX_LEN;
+}
+
+// メッセージに添付されたout-of-lineバッファ (ool型フィールド) の先頭アドレスと長さを
+// 指すポインタを返す。添付できない種類のメッセージの場合はfalseを返す。
+bool msg_ool(struct message *m, uaddr_t **uaddr, size_t **len) {
+    const struct message_layout *layout = msg_layout(m->type);
+    if (!layout || !layout->ool) {
+        return false;
+    }
+
+    *uaddr = (uaddr_t *) &m->data[layout->ool_offset];
+    *len = (size_t *) &m->data[layout->ool_len_offset];
+    return true;
+}
@@ -8,19 +8,42 @@
 #define IPC_RECV    (1 << 17)
 #define IPC_NOBLOCK (1 << 18)
 #define IPC_KERNEL  (1 << 19)
+#define IPC_REPLY   (1 << 20)
+#define IPC_ASYNC   (1 << 21)
+#define IPC_FAST    (1 << 22)//（内核内部使用）消息通过寄存器传递
+#define IPC_CONTINUE (1 << 23)//（内核内部使用）等待时不保留内核栈，以 cont_done 结束
 #define IPC_CALL    (IPC_SEND | IPC_RECV)
+//回复一个任务后立即进入开放接收状态（服务器主循环用）
+#define IPC_REPLY_RECV (IPC_SEND | IPC_RECV | IPC_REPLY)
 
 #define NOTIFY_TIMER       (1 << 0)
 #define NOTIFY_IRQ         (1 << 1)
 #define NOTIFY_ABORTED     (1 << 2)
-#define NOTIFY_ASYNC_BASE  3
-#define NOTIFY_ASYNC(tid)  (1 << (NOTIFY_ASYNC_BASE + tid))
-#define NOTIFY_ASYNC_START (NOTIFY_ASYNC(0))
-#define NOTIFY_ASYNC_END   (NOTIFY_ASYNC(NUM_TASKS_MAX))
+//有任务发送了异步消息（或通道的通知）。发送方的任务ID由内核记录，并通过
+//NOTIFY_MSG消息的 async_src 字段每次告知一个。
+#define NOTIFY_ASYNC       (1 << 3)
 
-//每个任务在通知中都有一个专用的异步位字段
-STATIC_ASSERT(NOTIFY_ASYNC_BASE + NUM_TASKS_MAX < sizeof(notifications_t) * 8,
-              "too many tasks for notifications_t");
+//ipc_batch系统调用一次可以发送的最大消息数
+#define IPC_BATCH_MAX 16
+
+//ipc_batch系统调用的每个条目
+struct ipc_batch_entry {
+    task_t dst;//目标任务
+    unsigned flags;//附加的标志（只能指定IPC_ASYNC）
+    struct message *m;//要发送的消息
+    error_t err;//发送结果（由内核写入）
+};
+
+//每种消息的布局信息（由IPC存根生成器生成）。用于只复制消息中实际有效的部分。
+struct message_layout {
+    bool any;//内容任意：需要复制整个消息
+    uint16_t fixed_len;//不包括可变长度字段的字段大小
+    uint16_t len_offset;//保存可变长度字段实际长度的字段的偏移量
+    uint16_t max_var_len;//可变长度字段的最大长度（0表示没有可变长度字段）
+    bool ool;//是否有out-of-line缓冲区（ool类型）字段
+    uint16_t ool_offset;//out-of-line缓冲区地址字段的偏移量
+    uint16_t ool_len_offset;//out-of-line缓冲区长度字段的偏移量
+};
 
 struct message {
     int32_t type;//消息类型（负数则为错误值）
@@ -40,4 +63,20 @@ struct message {
 STATIC_ASSERT(sizeof(struct message) < 2048,
               "sizeof(struct message) too large");
 
+//用ipc_buffer系统调用登记的消息缓冲区的对齐。消息小于该值，因此按此对齐的
+//缓冲区不会跨页。
+#define MESSAGE_BUFFER_ALIGN 2048
+
+//消息头（type和src）的大小
+#define MESSAGE_HEADER_LEN (offsetof(struct message, data))
+
+//寄存器IPC (ipc_fast系统调用) 可以通过寄存器传递的数据字数
+#define IPC_FAST_WORDS 3
+//寄存器IPC可以传递的消息的最大长度
+#define IPC_FAST_MAX_LEN (MESSAGE_HEADER_LEN + IPC_FAST_WORDS * sizeof(uint32_t))
+
 const char *msgtype2str(int type);
+size_t msg_fixed_len(int type);
+size_t msg_len(const struct message *m);
+bool msg_fits_fast(const struct message *m);
+bool msg_ool(struct message *m, uaddr_t **uaddr, size_t **len);
@@ -131,7 +131,8 @@ typedef __builtin_va_list va_list;
 #define ERR_NOT_A_FILE      -25//不是一个文件
 #define ERR_NOT_A_DIR       -26//不是目录
 #define ERR_EOF             -27//文件数据结束
-#define ERR_END             -28//必须是最后一个错误码
+#define ERR_TIMEOUT         -28//超时
+#define ERR_END             -29//必须是最后一个错误码
 //内存页大小
 #define PAGE_SIZE 4096
 //页框编号偏移量
@@ -141,6 +142,40 @@ typedef __builtin_va_list va_list;
 //从页框号中提取物理地址
 #define PFN2PADDR(pfn) (((paddr_t) (pfn)) << PFN_OFFSET)
 
+//任务优先级的级数。0为最高优先级，TASK_PRIORITY_MAX - 1为最低优先级。
+#define TASK_PRIORITY_MAX 8
+//任务优先级的默认值
+#define TASK_PRIORITY_DEFAULT 4
+
+//每个任务可以同时使用的定时器数。定时器0用于time系统调用。
+#define TASK_TIMERS_MAX 8
+
+//任务ID的低位是任务表的索引（1～NUM_TASKS_MAX），高位是该索引被重复使用的次数（代）。
+//任务结束后，旧的任务ID不会被当作重复使用同一索引的新任务。
+#define TASK_INDEX_BITS 11
+#define TASK_INDEX_MASK ((1 << TASK_INDEX_BITS) - 1)
+#define TASK_INDEX(tid) ((tid) & TASK_INDEX_MASK)
+
+//允许在所有CPU上执行的CPU亲和性
+#define TASK_AFFINITY_ALL ((1u << NUM_CPUS_MAX) - 1)
+
+//任务的调度统计信息（sys_task_stats系统调用）。时间的单位是微秒。计数器会回绕，因此
+//请使用两次获取的值的差。
+struct task_stats {
+    task_t tid;                     //任务ID
+    char name[TASK_NAME_LEN];       //任务名称
+    int priority;                   //当前的优先级
+    int cpu;                        //最后执行的CPU（-1表示还没有执行过）
+    uint32_t runtime;               //累计执行时间
+    uint32_t voluntary_switches;    //因阻塞而让出CPU的次数
+    uint32_t involuntary_switches;  //因时间片用完或被抢占而让出CPU的次数
+    uint32_t migrations;            //在CPU之间迁移的次数
+    uint32_t wakeups;               //被唤醒的次数
+    uint32_t wakeup_latency;        //从被唤醒到开始执行的时间的总和
+    uint32_t wakeup_latency_max;    //从被唤醒到开始执行的最长时间
+    uint32_t rsv_overruns;          //用完预留CPU时间的次数
+};
+
 //如果从内核发送消息，则源任务 ID
 #define FROM_KERNEL -1
 //VM服务器的任务ID（第一个用户任务）
@@ -164,6 +199,19 @@ typedef __builtin_va_list va_list;
 #define SYS_UPTIME       15
 #define SYS_HINAVM       16
 #define SYS_SHUTDOWN     17
+#define SYS_OOL_WINDOW   18
+#define SYS_IPC_BATCH    19
+#define SYS_SERVICE_JOIN 20
+#define SYS_IPC_FAST     21
+#define SYS_IPC_BUFFER   22
+#define SYS_TASK_SET_PRIORITY 23
+#define SYS_TIMER_SET    24
+#define SYS_TASK_SET_AFFINITY 25
+#define SYS_TASK_SET_RESERVATION 26
+#define SYS_TASK_STATS   27
+#define SYS_THREAD_CREATE 28
+#define SYS_THREAD_EXIT  29
+#define SYS_PM_FREE      30
 
 //pm_alloc() 的标志
 #define PM_ALLOC_UNINITIALIZED 0//不需要清零
@@ -0,0 +1,181 @@
+// 通道：基于共享内存的单生产者单消费者 (SPSC) 环形缓冲区。
+//
+// 生产者和消费者不需要系统调用就能读写数据。只有当消费者表示即将进入等待状态
+// (consumer_idle) 时，生产者才通过通知 (NOTIFY_ASYNC) 唤醒它。消费者一侧的
+// libs/user 会把这个通知转换为 CHANNEL_READY_MSG 消息。
+#include <libs/common/print.h>
+#include <libs/common/string.h>
+#include <libs/user/channel.h>
+#include <libs/user/ipc.h>
+#include <libs/user/malloc.h>
+#include <libs/user/task.h>
+
+// 该任务的所有通道
+static list_t channels = LIST_INIT(channels);
+
+// 查找与 peer 之间的通道。
+static struct channel *find_channel(task_t peer, bool producer) {
+    LIST_FOR_EACH (ch, &channels, struct channel, next) {
+        if (ch->peer == peer && ch->producer == producer) {
+            return ch;
+        }
+    }
+
+    return NULL;
+}
+
+// 返回第 index 个槽。
+static struct channel_slot *slot_at(struct channel *ch, uint32_t index) {
+    size_t stride = sizeof(struct channel_slot) + ALIGN_UP(ch->slot_size, 4);
+    size_t offset = (index & (ch->num_slots - 1)) * stride;
+    return (struct channel_slot *) &ch->ring->slots[offset];
+}
+
+// 生成通道管理结构并注册到通道列表。
+static struct channel *register_channel(struct channel_ring *ring, task_t peer,
+                                        bool producer, uint32_t num_slots,
+                                        uint32_t slot_size) {
+    struct channel *ch = malloc(sizeof(*ch));
+    ch->ring = ring;
+    ch->peer = peer;
+    ch->producer = producer;
+    ch->async_query = false;
+    ch->num_slots = num_slots;
+    ch->slot_size = slot_size;
+    list_elem_init(&ch->next);
+    list_push_back(&channels, &ch->next);
+    return ch;
+}
+
+// 作为生产者创建通往 consumer 的通道。环形缓冲区通过虚拟机服务器分配，并映射到
+// 双方。consumer 一侧的地址返回到 consumer_uaddr，需要通过消息告诉 consumer，
+// 让它调用 channel_accept 函数。num_slots 必须是2的幂。失败时返回 NULL。
+channel_t channel_create(task_t consumer, size_t slot_size, size_t num_slots,
+                         uaddr_t *consumer_uaddr) {
+    ASSERT(num_slots > 0 && (num_slots & (num_slots - 1)) == 0);
+
+    size_t stride = sizeof(struct channel_slot) + ALIGN_UP(slot_size, 4);
+    size_t size = sizeof(struct channel_ring) + stride * num_slots;
+
+    struct message m;
+    m.type = VM_ALLOC_SHARED_MSG;
+    m.vm_alloc_shared.peer = consumer;
+    m.vm_alloc_shared.size = ALIGN_UP(size, PAGE_SIZE);
+    error_t err = ipc_call(VM_SERVER, &m);
+    if (err != OK) {
+        WARN("failed to allocate a shared memory for channel: %s",
+             err2str(err));
+        return NULL;
+    }
+
+    // 共享内存已经被清零。消费者一开始处于等待状态，这样第一个数据就会通知它。
+    struct channel_ring *ring =
+        (struct channel_ring *) m.vm_alloc_shared_reply.uaddr;
+    ring->consumer_idle = 1;
+    ring->num_slots = num_slots;
+    ring->slot_size = slot_size;
+
+    *consumer_uaddr = m.vm_alloc_shared_reply.peer_uaddr;
+    return register_channel(ring, consumer, true, num_slots, slot_size);
+}
+
+// 作为消费者接受由 producer 通过 channel_create 函数创建的通道。uaddr 是
+// channel_create 函数返回的 consumer_uaddr。
+channel_t channel_accept(task_t producer, uaddr_t uaddr) {
+    struct channel_ring *ring = (struct channel_ring *) uaddr;
+    uint32_t num_slots = ring->num_slots;
+    if (!num_slots || (num_slots & (num_slots - 1)) != 0) {
+        WARN("invalid channel from #%d (num_slots=%u)", producer, num_slots);
+        return NULL;
+    }
+
+    return register_channel(ring, producer, false, num_slots, ring->slot_size);
+}
+
+// 向通道写入数据（生产者）。通常不需要系统调用。如果缓冲区已满，则返回
+// ERR_TRY_AGAIN。
+error_t channel_send(channel_t ch, const void *data, size_t len) {
+    DEBUG_ASSERT(ch->producer);
+    if (len > ch->slot_size) {
+        return ERR_TOO_LARGE;
+    }
+
+    struct channel_ring *ring = ch->ring;
+    uint32_t head = ring->head;
+    uint32_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+    if (head - tail >= ch->num_slots) {
+        return ERR_TRY_AGAIN;
+    }
+
+    struct channel_slot *slot = slot_at(ch, head);
+    slot->len = len;
+    memcpy(slot->data, data, len);
+    __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+
+    // 只有当消费者表示即将进入等待状态时才通知它。与 channel_recv 函数中的
+    // 屏障配对，保证消费者要么看到新的 head，要么我们看到 consumer_idle。
+    full_memory_barrier();
+    if (__atomic_exchange_n(&ring->consumer_idle, 0, __ATOMIC_ACQ_REL)) {
+        return ipc_notify(ch->peer, NOTIFY_ASYNC);
+    }
+
+    return OK;
+}
+
+// 从通道读取一个数据（消费者）。返回读取的长度。通常不需要系统调用。
+//
+// 如果通道为空，则将消费者标记为等待状态并返回 ERR_EMPTY。之后生产者写入数据时，
+// 会收到 CHANNEL_READY_MSG 消息。
+int channel_recv(channel_t ch, void *buf, size_t buf_len) {
+    DEBUG_ASSERT(!ch->producer);
+
+    struct channel_ring *ring = ch->ring;
+    uint32_t tail = ring->tail;
+    uint32_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+    if (head == tail) {
+        // 告诉生产者即将进入等待状态，然后再检查一次，以免错过在此期间写入的数据。
+        __atomic_store_n(&ring->consumer_idle, 1, __ATOMIC_RELEASE);
+        full_memory_barrier();
+        head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+        if (head == tail) {
+            return ERR_EMPTY;
+        }
+
+        __atomic_store_n(&ring->consumer_idle, 0, __ATOMIC_RELEASE);
+    }
+
+    // 共享内存的内容可能被生产者随意改写，因此不信任其中的长度。
+    struct channel_slot *slot = slot_at(ch, tail);
+    size_t len = MIN(MIN((size_t) slot->len, (size_t) ch->slot_size), buf_len);
+    memcpy(buf, slot->data, len);
+    __atomic_store_n(&ring->tail, tail + 1, __ATOMIC_RELEASE);
+    return len;
+}
+
+// 收到来自 producer 的异步通知时由 libs/user 调用。如果它是通道的通知，则返回
+// true。*more 为 true 时，生产者还发送了异步消息，需要再次处理该通知。
+bool channel_doorbell(task_t producer, bool *more) {
+    struct channel *ch = find_channel(producer, false);
+    if (!ch) {
+        return false;
+    }
+
+    if (ch->async_query) {
+        // 上次已经作为通道的通知处理过了。这次接收异步消息。
+        ch->async_query = false;
+        return false;
+    }
+
+    *more = __atomic_exchange_n(&ch->ring->async_pending, 0, __ATOMIC_ACQ_REL);
+    ch->async_query = *more;
+    return true;
+}
+
+// 通过 ipc_send_async 函数向 consumer 发送异步消息时由 libs/user 调用。由于通道
+// 和异步消息共用同一个通知位，需要让消费者知道还有异步消息。
+void channel_mark_async(task_t consumer) {
+    struct channel *ch = find_channel(consumer, true);
+    if (ch) {
+        __atomic_store_n(&ch->ring->async_pending, 1, __ATOMIC_RELEASE);
+    }
+}
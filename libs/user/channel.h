@@ -0,0 +1,42 @@
+#pragma once
+#include <libs/common/list.h>
+#include <libs/common/types.h>
+
+// 单生产者单消费者 (SPSC) 环形缓冲区。放在生产者和消费者两个任务共享的内存中。
+struct channel_ring {
+    uint32_t head;           // 生产者下一个写入的槽的序号（只有生产者更新）
+    uint32_t tail;           // 消费者下一个读取的槽的序号（只有消费者更新）
+    uint32_t consumer_idle;  // 消费者即将进入等待状态（为1时生产者发送通知）
+    uint32_t async_pending;  // 生产者通过 ipc_send_async 发送了异步消息
+    uint32_t num_slots;      // 槽的数量（2的幂）
+    uint32_t slot_size;      // 每个槽可以存放的最大数据长度
+    uint8_t slots[];         // 槽的数组（struct channel_slot）
+};
+
+// 环形缓冲区中的每个槽
+struct channel_slot {
+    uint32_t len;    // 数据长度
+    uint8_t data[];  // 数据
+};
+
+// 通道管理结构（每个任务私有）
+struct channel {
+    list_elem_t next;           // 通道列表的元素
+    struct channel_ring *ring;  // 共享的环形缓冲区
+    task_t peer;                // 对方任务
+    bool producer;              // 该任务是否是生产者
+    bool async_query;           // 下一个来自生产者的通知需要作为异步消息处理
+    uint32_t num_slots;         // 槽的数量（不信任共享内存中的值，保留副本）
+    uint32_t slot_size;         // 每个槽的最大数据长度（同上）
+};
+
+// channel_t: 通道管理结构的指针
+typedef struct channel *channel_t;
+
+channel_t channel_create(task_t consumer, size_t slot_size, size_t num_slots,
+                         uaddr_t *consumer_uaddr);
+channel_t channel_accept(task_t producer, uaddr_t uaddr);
+error_t channel_send(channel_t ch, const void *data, size_t len);
+int channel_recv(channel_t ch, void *buf, size_t buf_len);
+bool channel_doorbell(task_t producer, bool *more);
+void channel_mark_async(task_t consumer);
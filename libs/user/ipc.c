@@ -1,6 +1,7 @@
 #include <libs/common/list.h>
 #include <libs/common/print.h>
 #include <libs/common/string.h>
+#include <libs/user/channel.h>
 #include <libs/user/ipc.h>
 #include <libs/user/malloc.h>
 #include <libs/user/syscall.h>
@@ -18,6 +19,10 @@ struct async_message {
 static list_t async_messages = LIST_INIT(async_messages);
 //收到通知（位字段）。
 static notifications_t pending_notifications = 0;
+//NOTIFY_ASYNC通知的发送方。内核每次只告知一个发送方。
+static task_t pending_async_src = 0;
+//已到期但还没有转换为消息的定时器ID的位图
+static uint32_t pending_timers = 0;
 
 //接收ASYNC_RECV_MSG时的处理（非阻塞）
 static error_t async_reply(task_t dst) {
@@ -29,7 +34,7 @@ static error_t async_reply(task_t dst) {
                 //如果已发送一条消息，ipc_reply 将失败
 //（目标任务未处于接收等待状态），请发送通知。
 //再次发送ASYNC_RECV_MSG。
-                return ipc_notify(dst, NOTIFY_ASYNC(task_self()));
+                return ipc_notify(dst, NOTIFY_ASYNC);
             }
 
             //回复未发送的消息
@@ -43,33 +48,119 @@ static error_t async_reply(task_t dst) {
     return OK;
 }
 
-//发送异步消息（非阻塞）
-error_t ipc_send_async(task_t dst, struct message *m) {
-    //将消息插入发送队列
+//发送队列中是否有发往 dst 的消息
+static bool async_queued(task_t dst) {
+    LIST_FOR_EACH (am, &async_messages, struct async_message, next) {
+        if (am->dst == dst) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+//将消息插入发送队列，并通知目标任务
+static error_t async_enqueue(task_t dst, struct message *m) {
     struct async_message *am = malloc(sizeof(*am));
     am->dst = dst;
     memcpy(&am->m, m, sizeof(am->m));
     list_elem_init(&am->next);
     list_push_back(&async_messages, &am->next);
 
+    //如果与目标任务之间有通道，则通知位是共用的，因此需要告诉它这次也有异步消息
+    channel_mark_async(dst);
+
     //向目标任务发送通知
-    return ipc_notify(dst, NOTIFY_ASYNC(task_self()));
+    return ipc_notify(dst, NOTIFY_ASYNC);
+}
+
+//发送异步消息（非阻塞）
+error_t ipc_send_async(task_t dst, struct message *m) {
+    //如果发送队列中没有发往 dst 的消息，则先尝试放入目标任务的内核邮箱。这样不需要
+    //通知和 ASYNC_RECV_MSG 的往返就能发送。已有排队的消息时，为了保持消息的顺序，
+    //继续放入发送队列。
+    if (!async_queued(dst)) {
+        error_t err = sys_ipc(dst, 0, m, IPC_SEND | IPC_ASYNC, 0);
+        if (err != ERR_WOULD_BLOCK) {
+            return err;
+        }
+
+        //邮箱已满: 退回到发送队列
+    }
+
+    return async_enqueue(dst, m);
+}
+
+//提交积累的条目，并将结果写回原来的条目。对于邮箱已满的异步消息，改为放入
+//发送队列。
+static error_t flush_batch(struct ipc_batch_entry *batch,
+                           struct ipc_batch_entry **orig, size_t num) {
+    error_t err = sys_ipc_batch(batch, num);
+    if (err != OK) {
+        return err;
+    }
+
+    for (size_t i = 0; i < num; i++) {
+        struct ipc_batch_entry *e = orig[i];
+        e->err = batch[i].err;
+        if ((e->flags & IPC_ASYNC) && e->err == ERR_WOULD_BLOCK) {
+            e->err = async_enqueue(e->dst, e->m);
+        }
+    }
+
+    return OK;
+}
+
+//批量发送多个消息。每 IPC_BATCH_MAX 个消息只需一次系统调用。各消息的发送结果
+//写入条目的 err。
+//
+//与 ipc_send_noblock 一样不阻塞。flags 中指定 IPC_ASYNC 的条目与 ipc_send_async
+//一样，无法立即发送时放入发送队列，因此一定会被送达。
+error_t ipc_send_batch(struct ipc_batch_entry *entries, size_t num) {
+    struct ipc_batch_entry batch[IPC_BATCH_MAX];
+    struct ipc_batch_entry *orig[IPC_BATCH_MAX];
+    size_t n = 0;
+    for (size_t i = 0; i < num; i++) {
+        struct ipc_batch_entry *e = &entries[i];
+        if ((e->flags & IPC_ASYNC) && async_queued(e->dst)) {
+            //为了保持消息的顺序，放入发送队列
+            e->err = async_enqueue(e->dst, e->m);
+            continue;
+        }
+
+        batch[n] = *e;
+        orig[n] = e;
+        n++;
+        if (n == IPC_BATCH_MAX) {
+            error_t err = flush_batch(batch, orig, n);
+            if (err != OK) {
+                return err;
+            }
+
+            n = 0;
+        }
+    }
+
+    return (n > 0) ? flush_batch(batch, orig, n) : OK;
 }
 
 //发送一个消息。阻塞直到目标任务处于接收状态。
 error_t ipc_send(task_t dst, struct message *m) {
-    return sys_ipc(dst, 0, m, IPC_SEND);
+    return sys_ipc(dst, 0, m, IPC_SEND, 0);
 }
 
 //发送一个消息。如果消息发送不能立即完成，则返回ERR_WOULD_BLOCK。
 error_t ipc_send_noblock(task_t dst, struct message *m) {
-    return sys_ipc(dst, 0, m, IPC_SEND | IPC_NOBLOCK);
+    return sys_ipc(dst, 0, m, IPC_SEND | IPC_NOBLOCK, 0);
 }
 
 //发送一个消息。如果无法立即完成消息发送，则会输出警告消息。
 //丢弃该消息。
 void ipc_reply(task_t dst, struct message *m) {
-    error_t err = ipc_send_noblock(dst, m);
+    //足够小的回复通过寄存器发送，内核不需要读取内存中的消息
+    error_t err = msg_fits_fast(m)
+                      ? arch_ipc_fast(dst, 0, IPC_SEND | IPC_NOBLOCK, m)
+                      : ipc_send_noblock(dst, m);
     OOPS_OK(err);
 }
 
@@ -97,15 +188,40 @@ static error_t recv_notification_as_message(struct message *m) {
             m->type = NOTIFY_IRQ_MSG;
             err = OK;
             break;
-        //超时通知
-        case NOTIFY_TIMER:
+        //超时通知：每次转换一个到期的定时器。还有其他到期的定时器时保留通知。
+        case NOTIFY_TIMER: {
+            int id = __builtin_ffs(pending_timers) - 1;
             m->type = NOTIFY_TIMER_MSG;
+            m->notify_timer.timer_id = (id < 0) ? 0 : id;
+            if (id >= 0) {
+                pending_timers &= ~(1 << id);
+            }
+
+            if (pending_timers) {
+                return OK;
+            }
+
             err = OK;
             break;
+        }
         //异步消息接收通知
-        case NOTIFY_ASYNC_START ... NOTIFY_ASYNC_END: {
+        case NOTIFY_ASYNC: {
+            //如果是通道的通知，则转换为CHANNEL_READY_MSG消息。如果通知发送者
+            //还发送了异步消息，则保留通知，下次再接收异步消息。
+            task_t src = pending_async_src;
+            bool more;
+            if (channel_doorbell(src, &more)) {
+                m->type = CHANNEL_READY_MSG;
+                m->channel_ready.producer = src;
+                if (more) {
+                    return OK;
+                }
+
+                err = OK;
+                break;
+            }
+
             //查询通知发送者是否有待处理的消息
-            task_t src = index - NOTIFY_ASYNC_BASE;
             m->type = ASYNC_RECV_MSG;
             err = ipc_call(src, m);
             break;
@@ -124,15 +240,29 @@ static error_t recv_notification_as_message(struct message *m) {
 
 //接收来自任何任务的消息（开放接收）。通知/异步消息传递
 //处理也是透明执行的。
-static error_t ipc_recv_any(struct message *m) {
+//
+//如果 reply_to 不为 0，则在接收之前将 m 作为回复发送给该任务。回复和接收通过
+//一次系统调用 (IPC_REPLY_RECV) 完成。
+static error_t ipc_recv_any(task_t reply_to, struct message *m) {
     while (true) {
         //如果有收到通知，则将通知转换为消息并返回。
         if (pending_notifications) {
+            if (reply_to) {
+                ipc_reply(reply_to, m);
+            }
+
             return recv_notification_as_message(m);
         }
 
-        //接收消息。
-        error_t err = sys_ipc(0, IPC_ANY, m, IPC_RECV);
+        //接收消息。需要回复时同时发送回复。
+        error_t err;
+        if (reply_to) {
+            err = sys_ipc(reply_to, IPC_ANY, m, IPC_REPLY_RECV, 0);
+            reply_to = 0;
+        } else {
+            err = sys_ipc(0, IPC_ANY, m, IPC_RECV, 0);
+        }
+
         if (err != OK) {
             return err;
         }
@@ -149,6 +279,13 @@ static error_t ipc_recv_any(struct message *m) {
                 }
 
                 pending_notifications |= m->notify.notifications;
+                if (m->notify.notifications & NOTIFY_TIMER) {
+                    pending_timers |= m->notify.timers;
+                }
+
+                if (m->notify.notifications & NOTIFY_ASYNC) {
+                    pending_async_src = m->notify.async_src;
+                }
                 return recv_notification_as_message(m);
             //异步消息查询处理：将任何异步消息返回给发送方任务。
             case ASYNC_RECV_MSG: {
@@ -176,11 +313,11 @@ static error_t ipc_recv_any(struct message *m) {
 error_t ipc_recv(task_t src, struct message *m) {
     if (src == IPC_ANY) {
         //打开接收
-        return ipc_recv_any(m);
+        return ipc_recv_any(0, m);
     }
 
     //封闭式接待
-    error_t err = sys_ipc(0, src, m, IPC_RECV);
+    error_t err = sys_ipc(0, src, m, IPC_RECV, 0);
     if (err != OK) {
         return err;
     }
@@ -193,9 +330,42 @@ error_t ipc_recv(task_t src, struct message *m) {
     return OK;
 }
 
+//将 m 作为回复发送给 dst，然后接收来自任何任务的消息（开放接收）。与依次调用
+//ipc_reply 和 ipc_recv(IPC_ANY) 相同，但只需一次系统调用。用于服务器的主循环。
+//
+//与 ipc_reply 一样，如果无法立即完成回复，则丢弃回复。
+error_t ipc_reply_recv(task_t dst, struct message *m) {
+    return ipc_recv_any(dst, m);
+}
+
 //发送消息并等待收件人的消息。
 error_t ipc_call(task_t dst, struct message *m) {
-    error_t err = sys_ipc(dst, dst, m, IPC_CALL);
+    return ipc_call_timeout(dst, m, 0);
+}
+
+//发送消息并等待收件人的消息。如果在 timeout 毫秒内没有完成，则返回 ERR_TIMEOUT。
+//
+//超时后对方发送的回复会被丢弃（对方的 ipc_reply 失败），不会被误认为是下一个请求
+//的回复。
+error_t ipc_call_timeout(task_t dst, struct message *m, unsigned timeout) {
+    error_t err = sys_ipc(dst, dst, m, IPC_CALL, timeout);
+    if (err != OK) {
+        return err;
+    }
+
+    //如果返回错误消息，则返回该错误。
+    if (IS_ERROR(m->type)) {
+        return m->type;
+    }
+
+    return OK;
+}
+
+//与ipc_call相同，但消息和回复都通过寄存器传递（寄存器IPC）。只能用于请求和回复都
+//足够小（msg_fits_fast函数返回true）的RPC。回复太大时返回 ERR_TOO_LARGE。
+error_t ipc_call_fast(task_t dst, struct message *m) {
+    DEBUG_ASSERT(msg_fits_fast(m));
+    error_t err = arch_ipc_fast(dst, dst, IPC_CALL, m);
     if (err != OK) {
         return err;
     }
@@ -213,6 +383,13 @@ error_t ipc_notify(task_t dst, notifications_t notifications) {
     return sys_notify(dst, notifications);
 }
 
+//将 m 登记为消息缓冲区。之后用 m 接收消息时，内核会尽可能将发送方的消息直接
+//复制到 m（单次复制）。m 必须按 MESSAGE_BUFFER_ALIGN 对齐。用于在同一个缓冲区中
+//反复接收消息的服务器主循环。
+error_t ipc_set_buffer(struct message *m) {
+    return sys_ipc_buffer(m);
+}
+
 //注册您的服务。
 error_t ipc_register(const char *name) {
     struct message m;
@@ -5,10 +5,15 @@
 error_t ipc_send(task_t dst, struct message *m);
 error_t ipc_send_noblock(task_t dst, struct message *m);
 error_t ipc_send_async(task_t dst, struct message *m);
+error_t ipc_send_batch(struct ipc_batch_entry *entries, size_t num);
 void ipc_reply(task_t dst, struct message *m);
 void ipc_reply_err(task_t dst, error_t error);
 error_t ipc_recv(task_t src, struct message *m);
+error_t ipc_reply_recv(task_t dst, struct message *m);
 error_t ipc_call(task_t dst, struct message *m);
+error_t ipc_call_timeout(task_t dst, struct message *m, unsigned timeout);
+error_t ipc_call_fast(task_t dst, struct message *m);
 error_t ipc_notify(task_t dst, notifications_t notifications);
 error_t ipc_register(const char *name);
+error_t ipc_set_buffer(struct message *m);
 task_t ipc_lookup(const char *name);
@@ -1,4 +1,5 @@
 #pragma once
+#include <libs/common/message.h>
 #include <libs/common/types.h>
 
 // システムコール命令を発行する。
@@ -13,10 +14,43 @@ static inline uint32_t arch_syscall(uint32_t r0, uint32_t r1, uint32_t r2,
     register int32_t result __asm__("a0");   // 戻り値 (a0レジスタに戻ってくる)
 
     // ecall命令を実行し、カーネルのシステムコールハンドラ (riscv32_trap_handler) に処理を移す。
-    // 返り値がa0レジスタ (result変数) に戻ってくる。
+    // 返り値がa0レジスタ (result変数) に戻ってくる。カーネルは一時レジスタ (t0〜t6) を
+    // 保存しないので、破壊されるレジスタとして指定する。
     __asm__ __volatile__("ecall"
                          : "=r"(result)
                          : "r"(a0), "r"(a1), "r"(a2), "r"(a3), "r"(a4), "r"(a5)
-                         : "memory");
+                         : "memory", "t0", "t1", "t2", "t3", "t4", "t5", "t6");
     return result;
 }
+
+// レジスタIPC (ipc_fastシステムコール) を発行する。メッセージの種類とデータはa3、a4、
+// a6、a7レジスタで渡され、カーネルはメモリ上のメッセージを読み書きしない。受信した
+// メッセージは同じレジスタに、送信元タスクはa1レジスタに戻ってくる。
+static inline error_t arch_ipc_fast(task_t dst, task_t src, unsigned flags,
+                                    struct message *m) {
+    uint32_t *words = (uint32_t *) m->data;
+    register int32_t a0 __asm__("a0") = dst;           // 送信先タスク / 戻り値
+    register int32_t a1 __asm__("a1") = src;           // 受信元タスク / 送信元タスク
+    register int32_t a2 __asm__("a2") = flags;         // フラグ
+    register int32_t a3 __asm__("a3") = m->type;       // メッセージの種類
+    register int32_t a4 __asm__("a4") = words[0];      // データ (1ワード目)
+    register int32_t a5 __asm__("a5") = SYS_IPC_FAST;  // システムコール番号
+    register int32_t a6 __asm__("a6") = words[1];      // データ (2ワード目)
+    register int32_t a7 __asm__("a7") = words[2];      // データ (3ワード目)
+
+    __asm__ __volatile__("ecall"
+                         : "+r"(a0), "+r"(a1), "+r"(a3), "+r"(a4), "+r"(a6),
+                           "+r"(a7)
+                         : "r"(a2), "r"(a5)
+                         : "memory", "t0", "t1", "t2", "t3", "t4", "t5", "t6");
+
+    if (a0 == OK && (flags & IPC_RECV)) {
+        m->type = a3;
+        m->src = a1;
+        words[0] = a4;
+        words[1] = a6;
+        words[2] = a7;
+    }
+
+    return a0;
+}
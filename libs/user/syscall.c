@@ -3,9 +3,10 @@
 #include <libs/user/ipc.h>
 #include <libs/user/syscall.h>
 
-//ipc系统调用：发送和接收消息
-error_t sys_ipc(task_t dst, task_t src, struct message *m, unsigned flags) {
-    return arch_syscall(dst, src, (uintptr_t) m, flags, 0, SYS_IPC);
+//ipc系统调用：发送和接收消息（timeout为0时不超时）
+error_t sys_ipc(task_t dst, task_t src, struct message *m, unsigned flags,
+                unsigned timeout) {
+    return arch_syscall(dst, src, (uintptr_t) m, flags, timeout, SYS_IPC);
 }
 
 //通知系统调用：发送通知
@@ -36,6 +37,17 @@ __noreturn void sys_task_exit(void) {
     UNREACHABLE();
 }
 
+//thread_create系统调用：创建共享任务 tid 的地址空间的线程（只有寻呼任务可以调用）
+task_t sys_thread_create(task_t tid, uaddr_t ip, uaddr_t sp, uaddr_t arg) {
+    return arch_syscall(tid, ip, sp, arg, 0, SYS_THREAD_CREATE);
+}
+
+//thread_exit系统调用：终止正在运行的线程
+__noreturn void sys_thread_exit(void) {
+    arch_syscall(0, 0, 0, 0, 0, SYS_THREAD_EXIT);
+    UNREACHABLE();
+}
+
 //task_self系统调用：获取正在运行的任务的ID
 task_t sys_task_self(void) {
     return arch_syscall(0, 0, 0, 0, 0, SYS_TASK_SELF);
@@ -46,6 +58,11 @@ pfn_t sys_pm_alloc(task_t tid, size_t size, unsigned flags) {
     return arch_syscall(tid, size, flags, 0, 0, SYS_PM_ALLOC);
 }
 
+//pm_free系统调用：释放没有被映射的物理内存
+error_t sys_pm_free(task_t tid, pfn_t pfn, size_t size) {
+    return arch_syscall(tid, pfn, size, 0, 0, SYS_PM_FREE);
+}
+
 //vm_map系统调用：映射页面
 error_t sys_vm_map(task_t task, uaddr_t uaddr, paddr_t paddr, unsigned attrs) {
     return arch_syscall(task, uaddr, paddr, attrs, 0, SYS_VM_MAP);
@@ -91,3 +108,49 @@ __noreturn void sys_shutdown(void) {
     arch_syscall(0, 0, 0, 0, 0, SYS_SHUTDOWN);
     UNREACHABLE();
 }
+
+//ool_window系统调用：设置out-of-line缓冲区的接收窗口
+error_t sys_ool_window(void *base, size_t size) {
+    return arch_syscall((uintptr_t) base, size, 0, 0, 0, SYS_OOL_WINDOW);
+}
+
+//ipc_batch系统调用：批量发送多个消息
+error_t sys_ipc_batch(struct ipc_batch_entry *entries, size_t num) {
+    return arch_syscall((uintptr_t) entries, num, 0, 0, 0, SYS_IPC_BATCH);
+}
+
+//service_join系统调用：将任务作为服务的工作任务加入
+error_t sys_service_join(task_t leader, task_t worker) {
+    return arch_syscall(leader, worker, 0, 0, 0, SYS_SERVICE_JOIN);
+}
+
+//更改任务的优先级。
+error_t sys_task_set_priority(task_t tid, int priority) {
+    return arch_syscall(tid, priority, 0, 0, 0, SYS_TASK_SET_PRIORITY);
+}
+
+//更改任务的CPU亲和性（可以执行该任务的CPU的位图）。
+error_t sys_task_set_affinity(task_t tid, unsigned affinity) {
+    return arch_syscall(tid, affinity, 0, 0, 0, SYS_TASK_SET_AFFINITY);
+}
+
+//为任务预留CPU时间：每 period 毫秒中的 budget 毫秒以高优先级执行。budget 为零时取消。
+//只有寻呼任务可以调用。
+error_t sys_task_set_reservation(task_t tid, int budget, int period) {
+    return arch_syscall(tid, budget, period, 0, 0, SYS_TASK_SET_RESERVATION);
+}
+
+//获取任务表的索引不小于 TASK_INDEX(tid) 的第一个任务的调度统计信息，返回其任务ID。
+task_t sys_task_stats(task_t tid, struct task_stats *stats) {
+    return arch_syscall(tid, (uaddr_t) stats, 0, 0, 0, SYS_TASK_STATS);
+}
+
+//设置定时器。timeout 为零时取消。
+error_t sys_timer_set(int id, int timeout) {
+    return arch_syscall(id, timeout, 0, 0, 0, SYS_TIMER_SET);
+}
+
+//登记消息缓冲区。
+error_t sys_ipc_buffer(struct message *m) {
+    return arch_syscall((uaddr_t) m, 0, 0, 0, 0, SYS_IPC_BUFFER);
+}
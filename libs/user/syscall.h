@@ -4,16 +4,21 @@
 #include <libs/common/types.h>
 
 struct message;
+struct ipc_batch_entry;
 
-error_t sys_ipc(task_t dst, task_t src, struct message *m, unsigned flags);
+error_t sys_ipc(task_t dst, task_t src, struct message *m, unsigned flags,
+                unsigned timeout);
 error_t sys_notify(task_t dst, notifications_t notifications);
 task_t sys_task_create(const char *name, vaddr_t ip, task_t pager);
 task_t sys_hinavm(const char *name, hinavm_inst_t *insts, size_t num_insts,
                   task_t pager);
 error_t sys_task_destroy(task_t task);
 __noreturn void sys_task_exit(void);
+task_t sys_thread_create(task_t tid, uaddr_t ip, uaddr_t sp, uaddr_t arg);
+__noreturn void sys_thread_exit(void);
 task_t sys_task_self(void);
 pfn_t sys_pm_alloc(task_t tid, size_t size, unsigned flags);
+error_t sys_pm_free(task_t tid, pfn_t pfn, size_t size);
 error_t sys_vm_map(task_t task, uaddr_t uaddr, paddr_t paddr, unsigned attrs);
 error_t sys_vm_unmap(task_t task, uaddr_t uaddr);
 error_t sys_irq_listen(unsigned irq);
@@ -23,3 +28,12 @@ int sys_serial_read(const char *buf, int max_len);
 error_t sys_time(int milliseconds);
 int sys_uptime(void);
 __noreturn void sys_shutdown(void);
+error_t sys_ool_window(void *base, size_t size);
+error_t sys_ipc_batch(struct ipc_batch_entry *entries, size_t num);
+error_t sys_service_join(task_t leader, task_t worker);
+error_t sys_ipc_buffer(struct message *m);
+error_t sys_task_set_priority(task_t tid, int priority);
+error_t sys_timer_set(int id, int timeout);
+error_t sys_task_set_affinity(task_t tid, unsigned affinity);
+error_t sys_task_set_reservation(task_t tid, int budget, int period);
+task_t sys_task_stats(task_t tid, struct task_stats *stats);
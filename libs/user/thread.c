@@ -0,0 +1,61 @@
+// 线程：共享任务地址空间的执行单元。
+//
+// 每个线程有自己的任务ID、寄存器和消息缓冲区，内核分别调度它们。线程通过虚拟机
+// 服务器（寻呼任务）创建，缺页等都由所属任务的寻呼任务处理。
+//
+// 注意：libs/user 的 malloc 和 IPC 的全局状态（待处理的通知等）没有加锁，不能从多个
+// 线程同时使用。线程应该只使用自己的栈和调用者准备的数据，或者自己进行互斥。
+#include <libs/common/print.h>
+#include <libs/user/ipc.h>
+#include <libs/user/syscall.h>
+#include <libs/user/thread.h>
+
+// 线程的启动信息。放在线程栈的顶部。
+struct thread_start {
+    void (*func)(void *);  // 线程执行的函数
+    void *arg;             // 传递给 func 的参数
+};
+
+// 线程的入口点。从 a0 寄存器接收启动信息。
+__noreturn static void thread_entry(struct thread_start *start) {
+    start->func(start->arg);
+    sys_thread_exit();
+}
+
+// 创建执行 func(arg) 的线程。stack 和 stack_size 是调用者准备的线程栈，线程结束之前
+// 不能释放。成功时返回线程的任务ID，失败时返回错误。
+task_t thread_spawn(void (*func)(void *), void *arg, void *stack,
+                    size_t stack_size) {
+    uaddr_t sp = ALIGN_DOWN((uaddr_t) stack + stack_size, 16);
+    sp -= ALIGN_UP(sizeof(struct thread_start), 16);
+    if (sp < (uaddr_t) stack) {
+        return ERR_INVALID_ARG;
+    }
+
+    struct thread_start *start = (struct thread_start *) sp;
+    start->func = func;
+    start->arg = arg;
+
+    struct message m;
+    m.type = SPAWN_THREAD_MSG;
+    m.spawn_thread.ip = (uaddr_t) thread_entry;
+    m.spawn_thread.sp = sp;
+    m.spawn_thread.arg = (uaddr_t) start;
+    error_t err = ipc_call(VM_SERVER, &m);
+    if (err != OK) {
+        return err;
+    }
+
+    return m.spawn_thread_reply.thread;
+}
+
+// 获取正在运行的线程的任务ID。task_self 函数缓存的是主线程的任务ID，因此线程中使用
+// 该函数。
+task_t thread_self(void) {
+    return sys_task_self();
+}
+
+// 终止正在运行的线程。在主线程中调用时结束整个任务。
+__noreturn void thread_exit(void) {
+    sys_thread_exit();
+}
@@ -0,0 +1,7 @@
+#pragma once
+#include <libs/common/types.h>
+
+task_t thread_spawn(void (*func)(void *), void *arg, void *stack,
+                    size_t stack_size);
+task_t thread_self(void);
+__noreturn void thread_exit(void);
@@ -0,0 +1,40 @@
+// 定时器：每个任务最多可以同时使用 TASK_TIMERS_MAX 个定时器。定时器到期时会收到
+// NOTIFY_TIMER_MSG 消息，其 timer_id 字段为到期的定时器ID。
+//
+// 定时器0由 sys_time 系统调用使用，因此这里从1开始分配。
+#include <libs/common/print.h>
+#include <libs/user/syscall.h>
+#include <libs/user/timer.h>
+
+//已分配的定时器ID的位图
+static uint32_t allocated_timers = 1 << 0;
+
+//分配一个未使用的定时器ID。没有未使用的定时器时返回 ERR_NO_RESOURCES。
+int timer_alloc(void) {
+    for (int id = 1; id < TASK_TIMERS_MAX; id++) {
+        if (!(allocated_timers & (1 << id))) {
+            allocated_timers |= 1 << id;
+            return id;
+        }
+    }
+
+    return ERR_NO_RESOURCES;
+}
+
+//释放定时器ID。如果定时器正在运行，则取消它。
+void timer_free(int id) {
+    DEBUG_ASSERT(0 < id && id < TASK_TIMERS_MAX);
+    OOPS_OK(timer_cancel(id));
+    allocated_timers &= ~(1 << id);
+}
+
+//启动定时器，在 ms 毫秒后到期。如果定时器已经在运行，则重新设置到期时刻。
+error_t timer_set(int id, unsigned ms) {
+    DEBUG_ASSERT(ms > 0);
+    return sys_timer_set(id, ms);
+}
+
+//取消定时器。
+error_t timer_cancel(int id) {
+    return sys_timer_set(id, 0);
+}
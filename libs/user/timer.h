@@ -0,0 +1,7 @@
+#pragma once
+#include <libs/common/types.h>
+
+int timer_alloc(void);
+void timer_free(int id);
+error_t timer_set(int id, unsigned ms);
+error_t timer_cancel(int id);
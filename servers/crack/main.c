@@ -95,7 +95,7 @@ void main(void) {
     struct message m;
     m.type = DESTROY_TASK_MSG;
     m.destroy_task.task = blk_device;
-    ASSERT_OK(ipc_call(VM_SERVER, &m));
+    ASSERT_OK(ipc_call_fast(VM_SERVER, &m));
 
     INFO("reinitializing virtio_blk...");
     paddr_t base_paddr = VIRTIO_BLK_PADDR;
@@ -105,6 +105,11 @@ void block_mark_as_dirty(struct block *block) {
     }
 }
 
+//是否有需要写回磁盘的块。
+bool block_has_dirty(void) {
+    return !list_is_empty(&dirty_blocks);
+}
+
 //将所有修改的块写入磁盘。
 void block_flush_all(void) {
     LIST_FOR_EACH (b, &dirty_blocks, struct block, dirty_next) {
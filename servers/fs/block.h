@@ -23,5 +23,6 @@ struct block {
 
 error_t block_read(block_t index, struct block **block);
 void block_mark_as_dirty(struct block *block);
+bool block_has_dirty(void);
 void block_flush_all(void);
 void block_init(void);
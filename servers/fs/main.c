@@ -9,6 +9,9 @@
 //由所有任务共享。
 static struct open_file open_files[OPEN_FILES_MAX];
 
+//fs_read_pages的读取缓冲区。作为out-of-line缓冲区把页面直接移动给客户端。
+static __aligned(PAGE_SIZE) uint8_t read_pages_buf[READ_PAGES_MAX];
+
 //分配文件描述符。
 static int alloc_fd(void) {
     for (int i = 0; i < OPEN_FILES_MAX; i++) {
@@ -111,8 +114,11 @@ void main(void) {
     block_init();
     fs_init();
 
+    //主循环的消息缓冲区。登记后可以直接接收发送方的消息。
+    static struct message m __aligned(MESSAGE_BUFFER_ALIGN);
+    ASSERT_OK(ipc_set_buffer(&m));
+
     //注册通知Vm服务器任务完成
-    struct message m;
     m.type = WATCH_TASKS_MSG;
     ASSERT_OK(ipc_call(VM_SERVER, &m));
 
@@ -120,13 +126,21 @@ void main(void) {
     ASSERT_OK(ipc_register("fs"));
     TRACE("ready");
 
+    //回复的目标任务。回复与下一条消息的接收一起进行（0 表示不回复）。
+    task_t reply_to = 0;
     while (true) {
+        //需要写回磁盘时先回复，以免客户端等待磁盘写回完成
+        if (reply_to && block_has_dirty()) {
+            ipc_reply(reply_to, &m);
+            reply_to = 0;
+        }
+
         //将修改后的块写回磁盘
         block_flush_all();
 
-        struct message m;
-        error_t err = ipc_recv(IPC_ANY, &m);
+        error_t err = ipc_reply_recv(reply_to, &m);
         ASSERT_OK(err);
+        reply_to = 0;
 
         switch (m.type) {
             case TASK_DESTROYED_MSG: {
@@ -143,19 +157,20 @@ void main(void) {
 
                 int fd_or_err = do_open(m.src, path);
                 if (IS_ERROR(fd_or_err)) {
-                    ipc_reply_err(m.src, fd_or_err);
+                    m.type = fd_or_err;
+                    reply_to = m.src;
                     break;
                 }
 
                 m.type = FS_OPEN_REPLY_MSG;
                 m.fs_open_reply.fd = fd_or_err;
-                ipc_reply(m.src, &m);
+                reply_to = m.src;
                 break;
             }
             case FS_CLOSE_MSG: {
                 free_fd(m.src, m.fs_close.fd);
                 m.type = FS_CLOSE_REPLY_MSG;
-                ipc_reply(m.src, &m);
+                reply_to = m.src;
                 break;
             }
             case FS_READ_MSG: {
@@ -164,14 +179,36 @@ void main(void) {
                 int read_len =
                     do_readwrite(m.src, m.fs_read.fd, buf, len, false);
                 if (IS_ERROR(read_len)) {
-                    ipc_reply_err(m.src, read_len);
+                    m.type = read_len;
+                    reply_to = m.src;
                     break;
                 }
 
                 m.type = FS_READ_REPLY_MSG;
                 memcpy(m.fs_read_reply.data, buf, read_len);
                 m.fs_read_reply.data_len = read_len;
-                ipc_reply(m.src, &m);
+                reply_to = m.src;
+                break;
+            }
+            case FS_READ_PAGES_MSG: {
+                size_t len = MIN(m.fs_read_pages.len, sizeof(read_pages_buf));
+                int read_len = do_readwrite(m.src, m.fs_read_pages.fd,
+                                            read_pages_buf, len, false);
+                if (IS_ERROR(read_len)) {
+                    m.type = read_len;
+                    reply_to = m.src;
+                    break;
+                }
+
+                //移动的是整个页面，因此将最后一页的剩余部分清零，以免之前读取的
+                //数据泄露给客户端。
+                memset(&read_pages_buf[read_len], 0,
+                       ALIGN_UP(read_len, PAGE_SIZE) - read_len);
+
+                m.type = FS_READ_PAGES_REPLY_MSG;
+                m.fs_read_pages_reply.data = (uaddr_t) read_pages_buf;
+                m.fs_read_pages_reply.data_len = read_len;
+                reply_to = m.src;
                 break;
             }
             case FS_WRITE_MSG: {
@@ -180,13 +217,14 @@ void main(void) {
                                                   m.fs_write.data, len, true);
                 if (IS_ERROR(written_len)) {
                     WARN("failed to write a file (%s)", err2str(written_len));
-                    ipc_reply_err(m.src, written_len);
+                    m.type = written_len;
+                    reply_to = m.src;
                     break;
                 }
 
                 m.type = FS_WRITE_REPLY_MSG;
                 m.fs_write_reply.written_len = written_len;
-                ipc_reply(m.src, &m);
+                reply_to = m.src;
                 break;
             }
             case FS_READDIR_MSG: {
@@ -196,7 +234,8 @@ void main(void) {
                 struct hinafs_entry *entry;
                 error_t err = fs_readdir(path, m.fs_readdir.index, &entry);
                 if (IS_ERROR(err)) {
-                    ipc_reply_err(m.src, err);
+                    m.type = err;
+                    reply_to = m.src;
                     break;
                 }
 
@@ -206,7 +245,7 @@ void main(void) {
                 m.fs_readdir_reply.type = entry->type;
                 m.fs_readdir_reply.filesize =
                     (entry->type == FS_TYPE_FILE) ? entry->size : 0;
-                ipc_reply(m.src, &m);
+                reply_to = m.src;
                 break;
             }
             case FS_MKFILE_MSG: {
@@ -215,12 +254,13 @@ void main(void) {
 
                 error_t err = fs_create(path, FS_TYPE_FILE);
                 if (err != OK) {
-                    ipc_reply_err(m.src, err);
+                    m.type = err;
+                    reply_to = m.src;
                     break;
                 }
 
                 m.type = FS_MKFILE_REPLY_MSG;
-                ipc_reply(m.src, &m);
+                reply_to = m.src;
                 break;
             }
             case FS_MKDIR_MSG: {
@@ -229,12 +269,13 @@ void main(void) {
 
                 error_t err = fs_create(path, FS_TYPE_DIR);
                 if (IS_ERROR(err)) {
-                    ipc_reply_err(m.src, err);
+                    m.type = err;
+                    reply_to = m.src;
                     break;
                 }
 
                 m.type = FS_MKDIR_REPLY_MSG;
-                ipc_reply(m.src, &m);
+                reply_to = m.src;
                 break;
             }
             case FS_DELETE_MSG: {
@@ -243,12 +284,13 @@ void main(void) {
 
                 error_t err = fs_delete(path);
                 if (IS_ERROR(err)) {
-                    ipc_reply_err(m.src, err);
+                    m.type = err;
+                    reply_to = m.src;
                     break;
                 }
 
                 m.type = FS_DELETE_REPLY_MSG;
-                ipc_reply(m.src, &m);
+                reply_to = m.src;
                 break;
             }
             default:
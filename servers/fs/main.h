@@ -3,6 +3,7 @@
 
 #define WRITE_BACK_INTERVAL 1000
 #define OPEN_FILES_MAX      64
+#define READ_PAGES_MAX      (1024 * 1024)//fs_read_pages一次最多读取的字节数
 
 //打开文件信息
 struct open_file {
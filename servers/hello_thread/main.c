@@ -0,0 +1,45 @@
+#include <libs/common/print.h>
+#include <libs/common/string.h>
+#include <libs/user/ipc.h>
+#include <libs/user/task.h>
+#include <libs/user/thread.h>
+
+#define NUM_THREADS 3
+
+// メインスレッドのタスクID
+static task_t main_thread;
+// 各スレッドのスタック
+static uint8_t stacks[NUM_THREADS][PAGE_SIZE] __aligned(PAGE_SIZE);
+// 各スレッドが初めて書き込むページ (スレッドからのページフォルトを起こす)
+static uint8_t pages[NUM_THREADS][PAGE_SIZE] __aligned(PAGE_SIZE);
+
+// スレッドの本体。自分のページに書き込んで、その値をメインスレッドに送る。
+static void thread_main(void *arg) {
+    int index = (int) (uintptr_t) arg;
+    memset(pages[index], index + 1, PAGE_SIZE);
+
+    struct message m;
+    m.type = PING_MSG;
+    m.ping.value = pages[index][PAGE_SIZE - 1];
+    OOPS_OK(ipc_send(main_thread, &m));
+}
+
+void main(void) {
+    // task_self関数はタスクIDをキャッシュするので、スレッドを生成する前に取得しておく
+    main_thread = task_self();
+    for (int i = 0; i < NUM_THREADS; i++) {
+        // スレッドを生成する
+        task_t thread =
+            thread_spawn(thread_main, (void *) (uintptr_t) i, stacks[i],
+                         sizeof(stacks[i]));
+        ASSERT_OK(thread);
+
+        // スレッドからの値を待つ。スレッドは送信後に終了する。
+        struct message m;
+        ASSERT_OK(ipc_recv(thread, &m));
+        ASSERT(m.type == PING_MSG);
+        INFO("thread #%d: value=%d", thread, m.ping.value);
+    }
+
+    INFO("all threads done");
+}
@@ -97,6 +97,16 @@ static void do_start(struct args *args) {
     }
 }
 
+// 指定したミリ秒だけ待つ。
+static void sleep_ms(int ms) {
+    ASSERT_OK(sys_time(ms));
+
+    struct message m;
+    do {
+        ipc_recv(IPC_ANY, &m);
+    } while (m.type != NOTIFY_TIMER_MSG);
+}
+
 static void do_sleep(struct args *args) {
     if (args->argc != 2) {
         WARN("Usage: sleep <SECONDS>");
@@ -110,13 +120,7 @@ static void do_sleep(struct args *args) {
     }
 
     INFO("sleeping for %d seconds", seconds);
-
-    ASSERT_OK(sys_time(seconds * 1000));
-
-    struct message m;
-    do {
-        ipc_recv(IPC_ANY, &m);
-    } while (m.type != NOTIFY_TIMER_MSG);
+    sleep_ms(seconds * 1000);
 }
 
 static void do_ping(struct args *args) {
@@ -131,7 +135,7 @@ static void do_ping(struct args *args) {
     struct message m;
     m.type = PING_MSG;
     m.ping.value = atoi(args->argv[1]);
-    ASSERT_OK(ipc_call(pong_server, &m));
+    ASSERT_OK(ipc_call_fast(pong_server, &m));
 
     // pongサーバからの応答が想定されたものか確認する
     ASSERT(m.type == PING_REPLY_MSG);
@@ -142,6 +146,57 @@ static void do_uptime(struct args *args) {
     printf("%d seconds\n", sys_uptime());
 }
 
+// 各タスクのCPU使用率などのスケジューラの統計情報を表示する。一定時間をおいて統計情報を
+// 2回取得し、その差を表示する (カウンタは回り込むので差だけが意味を持つ)。
+static void do_top(struct args *args) {
+    int seconds = (args->argc >= 2) ? atoi(args->argv[1]) : 1;
+    if (seconds <= 0) {
+        WARN("Usage: top [SECONDS]");
+        return;
+    }
+
+    // 1回目の統計情報をタスク表のインデックスごとに保存する
+    static struct task_stats before[NUM_TASKS_MAX + 1];
+    memset(before, 0, sizeof(before));
+    struct task_stats stats;
+    task_t tid = 1;
+    while ((tid = sys_task_stats(tid, &stats)) > 0) {
+        before[TASK_INDEX(tid)] = stats;
+        tid = TASK_INDEX(tid) + 1;
+    }
+
+    sleep_ms(seconds * 1000);
+
+    // %CPUは1つのCPUに対する割合 (0.1%単位)。待ち時間は起床してから実行されるまでの時間。
+    printf("  TID CPU PRI  %%CPU   VCSW   ICSW  MIGR  WAKE  LAT(us)  MAX(us)"
+           "  OVR NAME\n");
+    tid = 1;
+    struct task_stats after;
+    while ((tid = sys_task_stats(tid, &after)) > 0) {
+        struct task_stats *prev = &before[TASK_INDEX(tid)];
+        tid = TASK_INDEX(tid) + 1;
+        if (prev->tid != after.tid) {
+            // 1回目の後に起動したタスク
+            continue;
+        }
+
+        unsigned runtime = after.runtime - prev->runtime;
+        unsigned permille = runtime / seconds / 1000;
+        unsigned wakeups = after.wakeups - prev->wakeups;
+        unsigned latency =
+            wakeups ? (after.wakeup_latency - prev->wakeup_latency) / wakeups
+                    : 0;
+        printf("%5d %3d %3d %3u.%u %6u %6u %5u %5u %8u %8u %4u %s\n",
+               after.tid, after.cpu, after.priority, permille / 10,
+               permille % 10,
+               after.voluntary_switches - prev->voluntary_switches,
+               after.involuntary_switches - prev->involuntary_switches,
+               after.migrations - prev->migrations, wakeups, latency,
+               after.wakeup_latency_max, after.rsv_overruns - prev->rsv_overruns,
+               after.name);
+    }
+}
+
 __noreturn static void do_shutdown(struct args *args) {
     INFO("shutting down...");
     sys_shutdown();
@@ -161,6 +216,7 @@ static struct command commands[] = {
     {.name = "sleep", .run = do_sleep, .help = "Pause for a while"},
     {.name = "ping", .run = do_ping, .help = "Send a ping to pong server"},
     {.name = "uptime", .run = do_uptime, .help = "Show seconds since boot"},
+    {.name = "top", .run = do_top, .help = "Show CPU usage of each task"},
     {.name = "shutdown", .run = do_shutdown, .help = "Shut down the system"},
     {.name = NULL},
 };
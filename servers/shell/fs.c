@@ -3,6 +3,11 @@
 #include <libs/common/string.h>
 #include <libs/user/ipc.h>
 #include <libs/user/malloc.h>
+#include <libs/user/syscall.h>
+
+// fs_read_pages で受け取るout-of-lineバッファの受信ウィンドウ。fsサーバが一度に返す
+// 最大の長さ (1 MiB) に合わせる。ページは実際に使われるまで割り当てられない。
+static __aligned(PAGE_SIZE) uint8_t read_window[1024 * 1024];
 
 void fs_read(const char *path) {
     task_t fs_server = ipc_lookup("fs");
@@ -20,26 +25,35 @@ void fs_read(const char *path) {
     ASSERT(m.type == FS_OPEN_REPLY_MSG);
     int fd = m.fs_open_reply.fd;
 
+    ASSERT_OK(sys_ool_window(read_window, sizeof(read_window)));
     while (true) {
-        m.type = FS_READ_MSG;
-        m.fs_read.fd = fd;
-        m.fs_read.len = PAGE_SIZE;
-        error_t err = err = ipc_call(fs_server, &m);
+        m.type = FS_READ_PAGES_MSG;
+        m.fs_read_pages.fd = fd;
+        m.fs_read_pages.len = sizeof(read_window);
+        error_t err = ipc_call(fs_server, &m);
         if (err == ERR_EOF) {
             break;
         }
 
         if (IS_ERROR(err)) {
             WARN("failed to read a file: %s", err2str(err));
-            return;
+            break;
         }
 
-        ASSERT(m.type == FS_READ_REPLY_MSG);
-        unsigned end =
-            MIN(sizeof(m.fs_read_reply.data) - 1, m.fs_read_reply.data_len);
-        m.fs_read_reply.data[end] = '\0';
-        DBG("%s", m.fs_read_reply.data);
+        // ファイルの内容はページごと受信ウィンドウに移動されてくる。
+        ASSERT(m.type == FS_READ_PAGES_REPLY_MSG);
+        ASSERT(m.fs_read_pages_reply.data == (uaddr_t) read_window);
+        size_t len = MIN(m.fs_read_pages_reply.data_len, sizeof(read_window));
+        for (size_t off = 0; off < len; off += 512) {
+            char tmp[513];
+            size_t chunk_len = MIN(len - off, sizeof(tmp) - 1);
+            memcpy(tmp, &read_window[off], chunk_len);
+            tmp[chunk_len] = '\0';
+            DBG("%s", tmp);
+        }
     }
+
+    ASSERT_OK(sys_ool_window(NULL, 0));
 }
 
 void fs_write(const char *path, const uint8_t *buf, size_t len) {
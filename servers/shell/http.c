@@ -5,6 +5,9 @@
 #include <libs/user/ipc.h>
 #include <libs/user/malloc.h>
 
+// DNSの名前解決を待つ最大時間 (ミリ秒)
+#define DNS_RESOLVE_TIMEOUT 5000
+
 static task_t tcpip_server;
 
 static void send(int sock, const uint8_t *buf, size_t len) {
@@ -87,7 +90,13 @@ static error_t resolve_url(const char *url, uint32_t *ip_addr, uint16_t *port,
         m.type = TCPIP_DNS_RESOLVE_MSG;
         strcpy_safe(m.tcpip_dns_resolve.hostname,
                     sizeof(m.tcpip_dns_resolve.hostname), host);
-        ASSERT_OK(ipc_call(tcpip_server, &m));
+        // DNSサーバから応答がないとTCP/IPサーバは返信しないので、タイムアウトを設定する。
+        error_t err = ipc_call_timeout(tcpip_server, &m, DNS_RESOLVE_TIMEOUT);
+        if (err != OK) {
+            WARN("failed to resolve '%s': %s", host, err2str(err));
+            free(s_orig);
+            return err;
+        }
 
         *ip_addr = m.tcpip_dns_resolve_reply.addr;
     }
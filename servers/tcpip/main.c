@@ -7,14 +7,28 @@
 #include <libs/common/list.h>
 #include <libs/common/print.h>
 #include <libs/common/string.h>
+#include <libs/user/channel.h>
 #include <libs/user/ipc.h>
 #include <libs/user/malloc.h>
 #include <libs/user/syscall.h>
+#include <libs/user/timer.h>
 
 // ネットワークデバイスドライバサーバ
 static task_t net_device;
+// ネットワークデバイスドライバからの受信パケットのチャネル
+static channel_t rx_channel;
+// ネットワークデバイスドライバへの送信パケットのチャネル
+static channel_t tx_channel;
 // ソケット管理構造体
 static struct socket sockets[SOCKETS_MAX];
+// ソケットの所有タスクへ送る、まだ送信していないイベントメッセージ
+static struct message socket_events[IPC_BATCH_MAX];
+// socket_eventsの送信先
+static struct ipc_batch_entry socket_event_entries[IPC_BATCH_MAX];
+// socket_eventsに溜まっているイベントの数
+static size_t num_socket_events = 0;
+// TCPの再送処理などの定期的な処理に使うタイマーのID
+static int flush_timer;
 
 // ソケットIDを割り当てる。使えるソケットIDがなければ0を返す。
 static struct socket *alloc_socket(void) {
@@ -73,15 +87,58 @@ void callback_ethernet_transmit(mbuf_t pkt) {
     mbuf_read(&pkt, payload, len);
     mbuf_delete(pkt);
 
-    m.type = NET_SEND_MSG;
-    m.net_send.payload_len = len;
-    memcpy(m.net_send.payload, payload, len);
-    error_t err = ipc_send_async(net_device, &m);
+    error_t err;
+    if (tx_channel) {
+        // チャネルに書き込むだけで、通常はシステムコールを必要としない。
+        err = channel_send(tx_channel, payload, len);
+    } else {
+        m.type = NET_SEND_MSG;
+        m.net_send.payload_len = len;
+        memcpy(m.net_send.payload, payload, len);
+        err = ipc_send_async(net_device, &m);
+    }
+
+    free(payload);
     if (err != OK) {
         WARN("failed to send packet to driver: %s", err2str(err));
     }
 }
 
+// ネットワークデバイスドライバからチャネル経由で届いたパケットをすべて処理する。
+static void receive_packets(void) {
+    static uint8_t packet[PACKET_LEN_MAX];
+    int len;
+    while ((len = channel_recv(rx_channel, packet, sizeof(packet))) >= 0) {
+        ethernet_receive(packet, len);
+        dhcp_receive();
+        dns_receive();
+    }
+}
+
+// 溜まっているソケットのイベントを一度のシステムコールでまとめて送信する。
+static void flush_socket_events(void) {
+    if (num_socket_events == 0) {
+        return;
+    }
+
+    OOPS_OK(ipc_send_batch(socket_event_entries, num_socket_events));
+    num_socket_events = 0;
+}
+
+// ソケットのイベントを溜めておく。メインループに戻ったときにまとめて送信する。
+static struct message *push_socket_event(struct socket *sock) {
+    if (num_socket_events == IPC_BATCH_MAX) {
+        flush_socket_events();
+    }
+
+    struct ipc_batch_entry *e = &socket_event_entries[num_socket_events];
+    e->dst = sock->task;
+    e->flags = IPC_ASYNC;
+    e->m = &socket_events[num_socket_events];
+    num_socket_events++;
+    return e->m;
+}
+
 // PCBからソケット構造体を取得する。
 static struct socket *get_socket_from_pcb(struct tcp_pcb *pcb) {
     ASSERT(pcb->arg != NULL);
@@ -92,30 +149,27 @@ static struct socket *get_socket_from_pcb(struct tcp_pcb *pcb) {
 void callback_tcp_data(struct tcp_pcb *pcb) {
     struct socket *sock = get_socket_from_pcb(pcb);
 
-    struct message m;
-    m.type = TCPIP_DATA_MSG;
-    m.tcpip_data.sock = sock->fd;
-    ipc_send_async(sock->task, &m);
+    struct message *m = push_socket_event(sock);
+    m->type = TCPIP_DATA_MSG;
+    m->tcpip_data.sock = sock->fd;
 }
 
 // TCPコネクションが閉じられたとき (パッシブクローズ) に呼ばれる。
 void callback_tcp_fin(struct tcp_pcb *pcb) {
     struct socket *sock = get_socket_from_pcb(pcb);
 
-    struct message m;
-    m.type = TCPIP_CLOSED_MSG;
-    m.tcpip_closed.sock = sock->fd;
-    ipc_send_async(sock->task, &m);
+    struct message *m = push_socket_event(sock);
+    m->type = TCPIP_CLOSED_MSG;
+    m->tcpip_closed.sock = sock->fd;
 }
 
 // TCPコネクションがリセットされたときに呼ばれる。
 void callback_tcp_rst(struct tcp_pcb *pcb) {
     struct socket *sock = get_socket_from_pcb(pcb);
 
-    struct message m;
-    m.type = TCPIP_CLOSED_MSG;
-    m.tcpip_closed.sock = sock->fd;
-    ipc_send_async(sock->task, &m);
+    struct message *m = push_socket_event(sock);
+    m->type = TCPIP_CLOSED_MSG;
+    m->tcpip_closed.sock = sock->fd;
 }
 
 // DNSサーバから応答が届いたときに呼ばれる。
@@ -129,17 +183,28 @@ void callback_dns_got_answer(ipv4addr_t addr, void *arg) {
 void main(void) {
     TRACE("starting...");
 
+    // メインループのメッセージバッファ。登録しておくと送信元のメッセージを直接受信できる。
+    static struct message m __aligned(MESSAGE_BUFFER_ALIGN);
+    ASSERT_OK(ipc_set_buffer(&m));
+
     // ソケットの解放漏れがないように、タスクが終了したときに呼んでもらうように登録する。
-    struct message m;
     m.type = WATCH_TASKS_MSG;
     ASSERT_OK(ipc_call(VM_SERVER, &m));
 
     // ネットワークデバイスドライバに接続し、MACアドレスを取得する。
     net_device = ipc_lookup("net_device");
     ASSERT_OK(net_device);
+    // パケットの送受信にはチャネルを使う。作成できなかった場合はメッセージで送受信する。
+    uaddr_t tx_channel_uaddr = 0;
+    tx_channel = channel_create(net_device, PACKET_LEN_MAX, NET_CHANNEL_SLOTS,
+                                &tx_channel_uaddr);
     m.type = NET_OPEN_MSG;
+    m.net_open.tx_channel = tx_channel ? tx_channel_uaddr : 0;
     ASSERT_OK(ipc_call(net_device, &m));
     ASSERT(m.type == NET_OPEN_REPLY_MSG);
+    if (m.net_open_reply.rx_channel) {
+        rx_channel = channel_accept(net_device, m.net_open_reply.rx_channel);
+    }
 
     // プロトコルスタックを初期化する。
     device_init(&m.net_open_reply.macaddr);
@@ -160,6 +225,13 @@ void main(void) {
                 dhcp_receive();
                 break;
             }
+            case CHANNEL_READY_MSG: {
+                // ネットワークデバイスからチャネル経由でパケットが届いた。
+                if (rx_channel && m.channel_ready.producer == net_device) {
+                    receive_packets();
+                }
+                break;
+            }
             case TASK_DESTROYED_MSG: {
                 // まだ起動中なので解放すべきリソースがないため、単に無視する。
                 break;
@@ -171,24 +243,40 @@ void main(void) {
         }
     }
 
-    // 定期的な処理をするためにタイムアウトを設定する。
-    ASSERT_OK(sys_time(TIMER_INTERVAL));
+    // 定期的な処理をするためにタイマーを設定する。
+    flush_timer = timer_alloc();
+    ASSERT_OK(flush_timer);
+    ASSERT_OK(timer_set(flush_timer, TIMER_INTERVAL));
     // TCP/IPサーバとしてサービス登録をする。
     ASSERT_OK(ipc_register("tcpip"));
 
     TRACE("ready");
+
+    // 返信先のタスク。返信は次のメッセージの受信と同時に行う (0なら返信しない)。
+    task_t reply_to = 0;
     while (true) {
+        // 送信待ちのTCPパケットがあれば、クライアントがTCPの送信処理を待たないように
+        // 先に返信する。
+        if (reply_to && tcp_has_pending_output()) {
+            ipc_reply(reply_to, &m);
+            reply_to = 0;
+        }
+
         // TCPの送信処理を行う。
         tcp_flush();
+        // 前回のメッセージの処理中に発生したソケットのイベントを通知する。
+        flush_socket_events();
 
-        struct message m;
-        error_t err = ipc_recv(IPC_ANY, &m);
+        error_t err = ipc_reply_recv(reply_to, &m);
         ASSERT_OK(err);
+        reply_to = 0;
 
         switch (m.type) {
             case NOTIFY_TIMER_MSG: {
                 // メインループを回してtcp_flush関数を呼び出し、TCPの再送処理を行う
-                ASSERT_OK(sys_time(TIMER_INTERVAL));
+                if (m.notify_timer.timer_id == flush_timer) {
+                    ASSERT_OK(timer_set(flush_timer, TIMER_INTERVAL));
+                }
                 break;
             }
             case NET_RECV_MSG: {
@@ -198,6 +286,13 @@ void main(void) {
                 dns_receive();
                 break;
             }
+            case CHANNEL_READY_MSG: {
+                // ネットワークデバイスからチャネル経由でパケットが届いた。
+                if (rx_channel && m.channel_ready.producer == net_device) {
+                    receive_packets();
+                }
+                break;
+            }
             case TASK_DESTROYED_MSG: {
                 // タスクが終了したので、関連するリソースを解放する。
                 if (m.src != 1) {
@@ -222,7 +317,8 @@ void main(void) {
                                           m.tcpip_connect.dst_port);
                 if (err != OK) {
                     sock->used = false;
-                    ipc_reply_err(m.src, err);
+                    m.type = err;
+                    reply_to = m.src;
                     break;
                 }
 
@@ -237,7 +333,8 @@ void main(void) {
             case TCPIP_WRITE_MSG: {
                 struct socket *sock = lookup_socket(m.src, m.tcpip_write.sock);
                 if (!sock) {
-                    ipc_reply_err(m.src, ERR_INVALID_ARG);
+                    m.type = ERR_INVALID_ARG;
+                    reply_to = m.src;
                     break;
                 }
 
@@ -245,13 +342,14 @@ void main(void) {
                           m.tcpip_write.data_len);
 
                 m.type = TCPIP_WRITE_REPLY_MSG;
-                ipc_reply(m.src, &m);
+                reply_to = m.src;
                 break;
             }
             case TCPIP_READ_MSG: {
                 struct socket *sock = lookup_socket(m.src, m.tcpip_read.sock);
                 if (!sock) {
-                    ipc_reply_err(m.src, ERR_INVALID_ARG);
+                    m.type = ERR_INVALID_ARG;
+                    reply_to = m.src;
                     break;
                 }
 
@@ -260,20 +358,21 @@ void main(void) {
                     tcp_read(sock->tcp_pcb, m.tcpip_read_reply.data,
                              sizeof(m.tcpip_read_reply.data));
 
-                ipc_reply(m.src, &m);
+                reply_to = m.src;
                 break;
             }
             case TCPIP_CLOSE_MSG: {
                 struct socket *sock = lookup_socket(m.src, m.tcpip_close.sock);
                 if (!sock) {
-                    ipc_reply_err(m.src, ERR_INVALID_ARG);
+                    m.type = ERR_INVALID_ARG;
+                    reply_to = m.src;
                     break;
                 }
 
                 free_socket(sock);
 
                 m.type = TCPIP_CLOSE_REPLY_MSG;
-                ipc_reply(m.src, &m);
+                reply_to = m.src;
                 break;
             }
             default:
@@ -7,6 +7,9 @@
 
 #define TIMER_INTERVAL 100
 #define SOCKETS_MAX    256
+// ネットワークデバイスドライバとの間のチャネルのスロット数とパケットの最大長
+#define NET_CHANNEL_SLOTS 64
+#define PACKET_LEN_MAX    1514
 
 // ソケット管理構造体
 struct socket {
@@ -377,6 +377,25 @@ void tcp_receive(ipv4addr_t dst, ipv4addr_t src, mbuf_t pkt) {
     tcp_process(pcb, src, src_ep.port, &header, pkt);
 }
 
+// tcp_flush関数で送信されるデータ・フラグがあるかどうかを返す。
+bool tcp_has_pending_output(void) {
+    LIST_FOR_EACH (pcb, &active_pcbs, struct tcp_pcb, next) {
+        if (pcb->retransmit_at && sys_uptime() < pcb->retransmit_at) {
+            continue;
+        }
+
+        if (pcb->pending_flags) {
+            return true;
+        }
+
+        if (pcb->state == TCP_STATE_ESTABLISHED && mbuf_len(pcb->tx_buf) > 0) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
 // 各PCBをチェックし、未送信データがあれば送信する。
 void tcp_flush(void) {
     LIST_FOR_EACH (pcb, &active_pcbs, struct tcp_pcb, next) {
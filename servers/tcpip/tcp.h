@@ -77,4 +77,5 @@ void tcp_close(struct tcp_pcb *sock);
 void tcp_write(struct tcp_pcb *sock, const void *data, size_t len);
 size_t tcp_read(struct tcp_pcb *sock, void *buf, size_t buf_len);
 void tcp_receive(ipv4addr_t dst, ipv4addr_t src, mbuf_t pkt);
+bool tcp_has_pending_output(void);
 void tcp_flush(void);
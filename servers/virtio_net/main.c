@@ -1,6 +1,7 @@
 #include "virtio_net.h"
 #include <libs/common/print.h>
 #include <libs/common/string.h>
+#include <libs/user/channel.h>
 #include <libs/user/dmabuf.h>
 #include <libs/user/driver.h>
 #include <libs/user/ipc.h>
@@ -13,6 +14,11 @@ static struct virtio_virtq *rx_virtq;//接收数据包的虚拟队列
 static struct virtio_virtq *tx_virtq;//发送数据包的virtqueue
 static dmabuf_t rx_dmabuf;//virtqueue 用于接收数据包的缓冲区
 static dmabuf_t tx_dmabuf;//virtqueue发送数据包使用的缓冲区
+static channel_t rx_channel;//向TCP/IP服务器传递接收数据包的通道
+static channel_t tx_channel;//从TCP/IP服务器接收发送数据包的通道
+static struct message rx_messages[IPC_BATCH_MAX];//不使用通道时积累的接收数据包消息
+static struct ipc_batch_entry rx_entries[IPC_BATCH_MAX];//rx_messages的发送目标
+static size_t num_rx_messages = 0;//rx_messages中积累的消息数
 //读取MAC地址
 static void read_macaddr(uint8_t *macaddr) {
     offset_t base = offsetof(struct virtio_net_config, macaddr);
@@ -60,6 +66,16 @@ static error_t transmit(const void *payload, size_t len) {
     return OK;
 }
 
+//将积累的接收数据包消息一次批量发送到TCP/IP服务器
+static void flush_rx_messages(void) {
+    if (num_rx_messages == 0) {
+        return;
+    }
+
+    OOPS_OK(ipc_send_batch(rx_entries, num_rx_messages));
+    num_rx_messages = 0;
+}
+
 //中断处理程序
 static void irq_handler(void) {
     //通知设备已收到中断
@@ -81,17 +97,35 @@ static void irq_handler(void) {
             //从描述符的物理地址获取对应的虚拟地址
             struct virtio_net_req *req = dmabuf_p2v(rx_dmabuf, chain[0].addr);
 
-            //发送数据包到 TCP/ip 服务器
-            struct message m;
-            m.type = NET_RECV_MSG;
-            memcpy(m.net_recv.payload, &req->payload, total_len);
-            m.net_recv.payload_len = total_len;
-            OOPS_OK(ipc_send(tcpip_server, &m));
+            //发送数据包到 TCP/ip 服务器。使用通道时通常不需要系统调用。
+            if (rx_channel) {
+                error_t err =
+                    channel_send(rx_channel, &req->payload, total_len);
+                if (err != OK) {
+                    WARN("dropped a received packet: %s", err2str(err));
+                }
+            } else {
+                //先积累消息，之后一次系统调用发送多个数据包
+                if (num_rx_messages == IPC_BATCH_MAX) {
+                    flush_rx_messages();
+                }
+
+                struct message *m = &rx_messages[num_rx_messages];
+                m->type = NET_RECV_MSG;
+                memcpy(m->net_recv.payload, &req->payload, total_len);
+                m->net_recv.payload_len = total_len;
+                rx_entries[num_rx_messages].dst = tcpip_server;
+                rx_entries[num_rx_messages].flags = IPC_ASYNC;
+                rx_entries[num_rx_messages].m = m;
+                num_rx_messages++;
+            }
 
             //将接收到的内存缓冲区放回到队列中
             virtq_push(rx_virtq, chain, 1);
         }
 
+        flush_rx_messages();
+
         //通知设备已重新插入接收队列
         virtq_notify(&device, rx_virtq);
     }
@@ -165,12 +199,38 @@ void main(void) {
             //打开网络设备
             case NET_OPEN_MSG: {
                 tcpip_server = m.src;//接收数据包的目的地
+
+                //建立与TCP/IP服务器之间的通道。如果失败则使用消息收发数据包。
+                if (m.net_open.tx_channel) {
+                    tx_channel = channel_accept(m.src, m.net_open.tx_channel);
+                }
+
+                uaddr_t rx_channel_uaddr = 0;
+                rx_channel =
+                    channel_create(m.src, VIRTIO_NET_MAX_PACKET_SIZE,
+                                   NUM_CHANNEL_SLOTS, &rx_channel_uaddr);
+
                 m.type = NET_OPEN_REPLY_MSG;
                 memcpy(m.net_open_reply.macaddr, macaddr,
                        sizeof(m.net_open_reply.macaddr));
+                m.net_open_reply.rx_channel = rx_channel ? rx_channel_uaddr : 0;
                 ipc_reply(m.src, &m);
                 break;
             }
+            //通过通道收到了要发送的数据包
+            case CHANNEL_READY_MSG: {
+                if (!tx_channel || m.channel_ready.producer != tcpip_server) {
+                    break;
+                }
+
+                static uint8_t payload[VIRTIO_NET_MAX_PACKET_SIZE];
+                int len;
+                while ((len = channel_recv(tx_channel, payload, sizeof(payload)))
+                       >= 0) {
+                    OOPS_OK(transmit(payload, len));
+                }
+                break;
+            }
             //发送数据包
             case NET_SEND_MSG: {
                 OOPS_OK(transmit(m.net_send.payload, m.net_send.payload_len));
@@ -1,4 +1,6 @@
 objs-y += main.o task.o bootfs.o pm.o page_fault.o bootfs_image.o
-cflags-y += -DBOOTFS_PATH='"$(bootfs_bin)"' -DBOOT_SERVERS='"$(BOOT_SERVERS)"'
+cflags-y += -DBOOTFS_PATH='"$(bootfs_bin)"' -DBOOT_SERVERS='"$(BOOT_SERVERS)"' \
+	-DBOOT_PRIORITIES='"$(BOOT_PRIORITIES)"' -DBOOT_AFFINITY='"$(BOOT_AFFINITY)"' \
+	-DBOOT_RESERVATIONS='"$(BOOT_RESERVATIONS)"'
 
 $(build_dir)/bootfs_image.o: $(bootfs_bin)
@@ -9,6 +9,60 @@
 #include <libs/user/syscall.h>
 #include <libs/user/task.h>
 
+//VM服务器自身的优先级。为了尽快处理页面错误，设为最高。
+#define VM_PRIORITY 0
+
+//从“服务器名:值”形式的以空格分隔的列表（如BOOT_PRIORITIES）中查找服务器的值。
+//如果找到则返回指向值开头的指针，否则返回 NULL。
+static const char *lookup_boot_config(const char *config, const char *name) {
+    size_t len = strlen(name);
+    while (*config != '\0') {
+        if (!strncmp(config, name, len) && config[len] == ':') {
+            return &config[len + 1];
+        }
+
+        //跳到下一个条目。
+        while (*config != '\0' && *config != ' ') {
+            config++;
+        }
+
+        while (*config == ' ') {
+            config++;
+        }
+    }
+
+    return NULL;
+}
+
+//启动服务器并应用BOOT_PRIORITIES中指定的优先级、BOOT_AFFINITY中指定的CPU亲和性和
+//BOOT_RESERVATIONS中指定的预留CPU时间（“预算/周期”形式，单位为毫秒）。
+static void spawn_server(struct bootfs_file *file) {
+    task_t tid = task_spawn(file);
+    ASSERT_OK(tid);
+
+    const char *priority = lookup_boot_config(BOOT_PRIORITIES, file->name);
+    if (priority) {
+        OOPS_OK(sys_task_set_priority(tid, atoi(priority)));
+    }
+
+    const char *affinity = lookup_boot_config(BOOT_AFFINITY, file->name);
+    if (affinity) {
+        OOPS_OK(sys_task_set_affinity(tid, atoi(affinity)));
+    }
+
+    const char *reservation = lookup_boot_config(BOOT_RESERVATIONS, file->name);
+    if (reservation) {
+        const char *period = strchr(reservation, '/');
+        if (period) {
+            OOPS_OK(sys_task_set_reservation(tid, atoi(reservation),
+                                             atoi(period + 1)));
+        } else {
+            WARN("invalid reservation for %s (expected budget/period)",
+                 file->name);
+        }
+    }
+}
+
 //自动启动Boot fs 中的服务器中的boot server 中指定的服务器。
 static void spawn_servers(void) {
     int num_launched = 0;
@@ -23,7 +77,7 @@ static void spawn_servers(void) {
             size_t len = strlen(file->name);
             if (!strncmp(file->name, startups, len)
                 && (startups[len] == '\0' || startups[len] == ' ')) {
-                ASSERT_OK(task_spawn(file));
+                spawn_server(file);
                 num_launched++;
                 break;
             }
@@ -46,6 +100,7 @@ static void spawn_servers(void) {
 }
 
 void main(void) {
+    ASSERT_OK(sys_task_set_priority(task_self(), VM_PRIORITY));
     bootfs_init();
     spawn_servers();
 
@@ -54,17 +109,24 @@ void main(void) {
     sys_time(5000);
 
     TRACE("ready");
+
+    //主循环的消息缓冲区。登记后可以直接接收发送方的消息。
+    static struct message m __aligned(MESSAGE_BUFFER_ALIGN);
+    ASSERT_OK(ipc_set_buffer(&m));
+
+    //回复的目标任务。回复与下一条消息的接收一起进行（0 表示不回复）。
+    task_t reply_to = 0;
     while (true) {
-        struct message m;
-        error_t err = ipc_recv(IPC_ANY, &m);
+        error_t err = ipc_reply_recv(reply_to, &m);
         ASSERT_OK(err);
+        reply_to = 0;
 
         switch (m.type) {
             case PING_MSG: {
                 int value = m.ping.value;
                 m.type = PING_REPLY_MSG;
                 m.ping_reply.value = value;
-                ipc_reply(m.src, &m);
+                reply_to = m.src;
                 break;
             }
             case NOTIFY_TIMER_MSG: {
@@ -75,10 +137,10 @@ void main(void) {
                 struct task *task = task_find(m.src);
                 ASSERT(task);
 
-                task->watch_tasks = true;
+                task_watch(task);
 
                 m.type = WATCH_TASKS_REPLY_MSG;
-                ipc_reply(m.src, &m);
+                reply_to = m.src;
                 break;
             }
             case SERVICE_LOOKUP_MSG: {
@@ -88,14 +150,14 @@ void main(void) {
                 char name[sizeof(m.service_lookup.name)];
                 strcpy_safe(name, sizeof(name), m.service_lookup.name);
 
-                task_t server_task = service_lookup_or_wait(task, name);
+                task_t server_task = service_lookup_or_wait(task, m.src, name);
                 if (server_task == ERR_WOULD_BLOCK) {
                     continue;
                 }
 
                 m.type = SERVICE_LOOKUP_REPLY_MSG;
                 m.service_lookup_reply.task = server_task;
-                ipc_reply(m.src, &m);
+                reply_to = m.src;
                 break;
             }
             case SERVICE_REGISTER_MSG: {
@@ -108,7 +170,7 @@ void main(void) {
                 service_register(task, name);
 
                 m.type = SERVICE_REGISTER_REPLY_MSG;
-                ipc_reply(m.src, &m);
+                reply_to = m.src;
                 break;
             }
             case SPAWN_TASK_MSG: {
@@ -117,25 +179,45 @@ void main(void) {
 
                 struct bootfs_file *file = bootfs_open(name);
                 if (!file) {
-                    ipc_reply_err(m.src, ERR_NOT_FOUND);
+                    m.type = ERR_NOT_FOUND;
+                    reply_to = m.src;
                     break;
                 }
 
                 task_t task_or_err = task_spawn(file);
                 if (IS_ERROR(task_or_err)) {
-                    ipc_reply_err(m.src, task_or_err);
+                    m.type = task_or_err;
+                    reply_to = m.src;
                     break;
                 }
 
                 m.type = SPAWN_TASK_REPLY_MSG;
                 m.spawn_task_reply.task = task_or_err;
-                ipc_reply(m.src, &m);
+                reply_to = m.src;
+                break;
+            }
+            case SPAWN_THREAD_MSG: {
+                struct task *task = task_find(m.src);
+                ASSERT(task);
+
+                task_t thread_or_err =
+                    task_spawn_thread(task, m.spawn_thread.ip,
+                                      m.spawn_thread.sp, m.spawn_thread.arg);
+                if (IS_ERROR(thread_or_err)) {
+                    m.type = thread_or_err;
+                    reply_to = m.src;
+                    break;
+                }
+
+                m.type = SPAWN_THREAD_REPLY_MSG;
+                m.spawn_thread_reply.thread = thread_or_err;
+                reply_to = m.src;
                 break;
             }
             case DESTROY_TASK_MSG: {
                 task_destroy_by_tid(m.destroy_task.task);
                 m.type = DESTROY_TASK_REPLY_MSG;
-                ipc_reply(m.src, &m);
+                reply_to = m.src;
                 break;
             }
             case VM_MAP_PHYSICAL_MSG: {
@@ -149,7 +231,7 @@ void main(void) {
 
                 m.type = VM_MAP_PHYSICAL_MSG;
                 m.vm_map_physical_reply.uaddr = uaddr;
-                ipc_reply(m.src, &m);
+                reply_to = m.src;
                 break;
             }
             case VM_ALLOC_PHYSICAL_MSG: {
@@ -165,7 +247,33 @@ void main(void) {
                 m.type = VM_ALLOC_PHYSICAL_REPLY_MSG;
                 m.vm_alloc_physical_reply.uaddr = uaddr;
                 m.vm_alloc_physical_reply.paddr = paddr;
-                ipc_reply(m.src, &m);
+                reply_to = m.src;
+                break;
+            }
+            case VM_ALLOC_SHARED_MSG: {
+                struct task *task = task_find(m.src);
+                ASSERT(task);
+
+                struct task *peer = task_lookup(m.vm_alloc_shared.peer);
+                if (!peer || peer == task) {
+                    m.type = ERR_INVALID_TASK;
+                    reply_to = m.src;
+                    break;
+                }
+
+                uaddr_t uaddr, peer_uaddr;
+                error_t err = alloc_shared_pages(
+                    task, peer, m.vm_alloc_shared.size, &uaddr, &peer_uaddr);
+                if (err != OK) {
+                    m.type = err;
+                    reply_to = m.src;
+                    break;
+                }
+
+                m.type = VM_ALLOC_SHARED_REPLY_MSG;
+                m.vm_alloc_shared_reply.uaddr = uaddr;
+                m.vm_alloc_shared_reply.peer_uaddr = peer_uaddr;
+                reply_to = m.src;
                 break;
             }
             case EXCEPTION_MSG: {
@@ -182,6 +290,12 @@ void main(void) {
 
                 switch (m.exception.reason) {
                     case EXP_GRACE_EXIT:
+                        if (m.exception.task != task->tid) {
+                            //线程结束了。任务的其他线程继续执行。
+                            task_destroy_thread(task, m.exception.task);
+                            break;
+                        }
+
                         task_destroy(task);
                         TRACE("%s exited gracefully", task->name);
                         break;
@@ -207,7 +321,6 @@ void main(void) {
                 struct task *task = task_find(m.page_fault.task);
                 ASSERT(task);
                 ASSERT(task->pager == task_self());
-                ASSERT(m.page_fault.task == task->tid);
 
                 error_t err =
                     handle_page_fault(task, m.page_fault.uaddr, m.page_fault.ip,
@@ -217,8 +330,9 @@ void main(void) {
                     break;
                 }
 
+                //回复发生缺页的线程。
                 m.type = PAGE_FAULT_REPLY_MSG;
-                ipc_reply(task->tid, &m);
+                reply_to = m.page_fault.task;
                 break;
             }
             default:
@@ -36,6 +36,13 @@ error_t map_pages(struct task *task, size_t size, int map_flags, paddr_t paddr,
     return OK;
 }
 
+//取消映射从uaddr开始的size字节的页面。跳过没有映射的页面。
+static void unmap_pages(struct task *task, uaddr_t uaddr, size_t size) {
+    for (offset_t offset = 0; offset < size; offset += PAGE_SIZE) {
+        sys_vm_unmap(task->tid, uaddr + offset);
+    }
+}
+
 //分配物理页并将它们映射到任务的页表。分配的虚拟地址返回到uaddr。
 error_t alloc_pages(struct task *task, size_t size, int alloc_flags,
                     int map_flags, paddr_t *paddr, uaddr_t *uaddr) {
@@ -48,3 +55,36 @@ error_t alloc_pages(struct task *task, size_t size, int alloc_flags,
     *paddr = PFN2PADDR(pfn);
     return map_pages(task, size, map_flags, *paddr, uaddr);
 }
+
+//分配由task和peer共享的物理页，并将它们映射到双方的页表。页面的所有者是task。
+//分配的虚拟地址分别返回到uaddr和peer_uaddr。
+error_t alloc_shared_pages(struct task *task, struct task *peer, size_t size,
+                           uaddr_t *uaddr, uaddr_t *peer_uaddr) {
+    size = ALIGN_UP(size, PAGE_SIZE);
+    pfn_t pfn = sys_pm_alloc(task->tid, size, PM_ALLOC_ZEROED);
+    if (IS_ERROR(pfn)) {
+        return pfn;
+    }
+
+    paddr_t paddr = PFN2PADDR(pfn);
+    *peer_uaddr = 0;
+    error_t err =
+        map_pages(task, size, PAGE_READABLE | PAGE_WRITABLE, paddr, uaddr);
+    if (err == OK) {
+        err = map_pages(peer, size, PAGE_READABLE | PAGE_WRITABLE, paddr,
+                        peer_uaddr);
+    }
+
+    //失败时取消已经建立的映射并释放页面。虚拟地址区域无法释放，只是不再使用。
+    if (err != OK) {
+        if (*uaddr) {
+            unmap_pages(task, *uaddr, size);
+        }
+        if (*peer_uaddr) {
+            unmap_pages(peer, *peer_uaddr, size);
+        }
+        OOPS_OK(sys_pm_free(task->tid, pfn, size));
+    }
+
+    return err;
+}
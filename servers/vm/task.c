@@ -8,15 +8,38 @@
 #include <libs/user/syscall.h>
 #include <libs/user/task.h>
 
-static struct task *tasks[NUM_TASKS_MAX];//任务管理结构
+static struct task *tasks[NUM_TASKS_MAX];//任务表（第 TASK_INDEX(tid) - 1 个）
+static task_t tids[NUM_TASKS_MAX];//任务表中各个槽的任务ID（线程的槽指向所属任务）
 static list_t services = LIST_INIT(services);//服务管理结构列表
-//从任务ID获取任务管理结构。
+static list_t waiters = LIST_INIT(waiters);//等待服务注册的任务列表
+static list_t watchers = LIST_INIT(watchers);//监控任务完成情况的任务列表
+
+//从任务ID获取任务管理结构。线程的任务ID返回所属任务的管理结构。如果任务已经结束
+//（任务ID的代不同），则返回 NULL。
 struct task *task_find(task_t tid) {
-    if (tid <= 0 || tid > NUM_TASKS_MAX) {
+    unsigned index = TASK_INDEX(tid);
+    if (tid <= 0 || index == 0 || index > NUM_TASKS_MAX) {
         PANIC("invalid tid %d", tid);
     }
 
-    return tasks[tid - 1];
+    return (tids[index - 1] == tid) ? tasks[index - 1] : NULL;
+}
+
+//从客户端指定的任务ID获取任务管理结构。与 task_find 不同，无效的任务ID也不会
+//PANIC，而是返回 NULL。
+struct task *task_lookup(task_t tid) {
+    unsigned index = TASK_INDEX(tid);
+    if (tid <= 0 || index == 0 || index > NUM_TASKS_MAX) {
+        return NULL;
+    }
+
+    return task_find(tid);
+}
+
+//在任务表中登记任务ID。task 为 NULL 时删除。
+static void register_tid(task_t tid, struct task *task) {
+    tasks[TASK_INDEX(tid) - 1] = task;
+    tids[TASK_INDEX(tid) - 1] = task ? tid : 0;
 }
 
 //从指定的 elf 文件生成任务。如果成功则返回任务 ID，如果不成功则返回错误。
@@ -67,8 +90,12 @@ task_t task_spawn(struct bootfs_file *file) {
     task->pager = task_self();
     task->ehdr = ehdr;
     task->phdrs = (elf_phdr_t *) ((uaddr_t) file_header + ehdr->e_phoff);
-    task->watch_tasks = false;
+    list_init(&task->threads);
     strcpy_safe(task->waiting_for, sizeof(task->waiting_for), "");
+    task->waiting_tid = 0;
+    list_elem_init(&task->waiter_next);
+    list_elem_init(&task->watcher_next);
+    list_elem_init(&task->worker_next);
 
     //在虚拟地址空间中搜索空虚拟地址区域的开头。动态创建虚拟地址
 //分配时避免与ELF段重叠。
@@ -93,73 +120,192 @@ task_t task_spawn(struct bootfs_file *file) {
     strcpy_safe(task->name, sizeof(task->name), file->name);
 
     //在任务id表中注册任务管理结构。
-    tasks[task->tid - 1] = task;
+    register_tid(task->tid, task);
     return task->tid;
 }
 
+//任务结束后更新服务。工作任务退出服务。代表任务结束时，将第一个工作任务提升为新的
+//代表任务，并让其余工作任务加入它（内核已经解散了原来的服务）。没有工作任务时注销
+//服务，之后同名的服务可以重新注册。
+static void service_remove_task(struct task *task) {
+    if (list_is_linked(&task->worker_next)) {
+        list_remove(&task->worker_next);
+        return;
+    }
+
+    LIST_FOR_EACH (s, &services, struct service, next) {
+        if (s->task != task->tid) {
+            continue;
+        }
+
+        struct task *leader =
+            LIST_POP_FRONT(&s->workers, struct task, worker_next);
+        if (!leader) {
+            INFO("service \"%s\" is down", s->name);
+            list_remove(&s->next);
+            free(s);
+            continue;
+        }
+
+        s->task = leader->tid;
+        LIST_FOR_EACH (worker, &s->workers, struct task, worker_next) {
+            error_t err = sys_service_join(leader->tid, worker->tid);
+            if (err != OK) {
+                WARN("%s: failed to rejoin service \"%s\": %s", worker->name,
+                     s->name, err2str(err));
+                list_remove(&worker->worker_next);
+            }
+        }
+
+        INFO("service \"%s\": %s took over as the leader", s->name,
+             leader->name);
+    }
+}
+
 //完成任务。
 void task_destroy(struct task *task) {
-    for (int i = 0; i < NUM_TASKS_MAX; i++) {
-        //通知监控任务任务完成。
-        struct task *server = tasks[i];
-        if (server && server->watch_tasks) {
-            struct message m;
-            m.type = TASK_DESTROYED_MSG;
-            m.task_destroyed.task = task->tid;
-            ipc_send_async(server->tid, &m);
+    //通知监控任务任务完成。所有监控任务的消息都相同，一次批量发送。
+    struct message m;
+    m.type = TASK_DESTROYED_MSG;
+    m.task_destroyed.task = task->tid;
+
+    list_remove(&task->watcher_next);
+    list_remove(&task->waiter_next);
+
+    struct ipc_batch_entry entries[IPC_BATCH_MAX];
+    size_t num = 0;
+    LIST_FOR_EACH (server, &watchers, struct task, watcher_next) {
+        entries[num].dst = server->tid;
+        entries[num].flags = IPC_ASYNC;
+        entries[num].m = &m;
+        num++;
+        if (num == IPC_BATCH_MAX) {
+            OOPS_OK(ipc_send_batch(entries, num));
+            num = 0;
         }
     }
 
-    //让内核终止任务。
+    OOPS_OK(ipc_send_batch(entries, num));
+
+    //让内核终止任务。内核也会一起终止它的所有线程。
     OOPS_OK(sys_task_destroy(task->tid));
+    service_remove_task(task);
+
+    //从任务id表中删除任务管理结构和线程。
+    LIST_FOR_EACH (thread, &task->threads, struct thread, next) {
+        register_tid(thread->tid, NULL);
+        list_remove(&thread->next);
+        free(thread);
+    }
+
+    register_tid(task->tid, NULL);
     free(task->file_header);
     free(task);
-
-    //从任务id表中删除任务管理结构。
-    tasks[task_self() - 1] = NULL;
 }
 
-//指定任务ID并结束任务。
+//指定任务ID并结束任务。如果是线程的任务ID，则只结束该线程。
 error_t task_destroy_by_tid(task_t tid) {
-    for (int i = 0; i < NUM_TASKS_MAX; i++) {
-        struct task *task = tasks[i];
-        if (task && task->tid == tid) {
-            task_destroy(task);
-            return OK;
+    struct task *task = task_lookup(tid);
+    if (!task) {
+        return ERR_NOT_FOUND;
+    }
+
+    if (tid != task->tid) {
+        task_destroy_thread(task, tid);
+        return OK;
+    }
+
+    task_destroy(task);
+    return OK;
+}
+
+//创建共享任务地址空间的线程。如果成功则返回线程的任务 ID，如果不成功则返回错误。
+task_t task_spawn_thread(struct task *task, uaddr_t ip, uaddr_t sp,
+                         uaddr_t arg) {
+    struct thread *thread = malloc(sizeof(*thread));
+    task_t tid_or_err = sys_thread_create(task->tid, ip, sp, arg);
+    if (IS_ERROR(tid_or_err)) {
+        free(thread);
+        return tid_or_err;
+    }
+
+    //在任务id表中注册线程。线程的缺页等都由所属任务的管理结构处理。
+    thread->tid = tid_or_err;
+    list_elem_init(&thread->next);
+    list_push_back(&task->threads, &thread->next);
+    register_tid(thread->tid, task);
+    return thread->tid;
+}
+
+//结束任务的线程。
+void task_destroy_thread(struct task *task, task_t tid) {
+    LIST_FOR_EACH (thread, &task->threads, struct thread, next) {
+        if (thread->tid == tid) {
+            OOPS_OK(sys_task_destroy(tid));
+            register_tid(tid, NULL);
+            list_remove(&thread->next);
+            free(thread);
+            return;
         }
     }
 
-    return ERR_NOT_FOUND;
+    WARN("%s: unknown thread #%d", task->name, tid);
+}
+
+//监控任务完成情况：之后每当有任务结束时，都会收到 TASK_DESTROYED_MSG 消息。
+void task_watch(struct task *task) {
+    if (!list_is_linked(&task->watcher_next)) {
+        list_push_back(&watchers, &task->watcher_next);
+    }
 }
 
 //注册您的服务。
 void service_register(struct task *task, const char *name) {
+    //如果已经有同名的服务，则作为该服务的工作任务加入。客户端仍然使用最初注册的
+    //任务ID，内核将每个请求分派给空闲的工作任务。
+    LIST_FOR_EACH (s, &services, struct service, next) {
+        if (!strcmp(s->name, name)) {
+            error_t err = sys_service_join(s->task, task->tid);
+            if (err != OK) {
+                WARN("%s: failed to join service \"%s\": %s", task->name, name,
+                     err2str(err));
+                return;
+            }
+
+            list_push_back(&s->workers, &task->worker_next);
+            INFO("service \"%s\": %s joined as a worker", name, task->name);
+            return;
+        }
+    }
+
     //注册您的服务。
     struct service *service = malloc(sizeof(*service));
     service->task = task->tid;
     strcpy_safe(service->name, sizeof(service->name), name);
+    list_init(&service->workers);
     list_elem_init(&service->next);
     list_push_back(&services, &service->next);
     INFO("service \"%s\" is up", name);
 
     //如果有任务正在等待该服务，则回复该任务以将其从等待状态释放。
-    for (int i = 0; i < NUM_TASKS_MAX; i++) {
-        struct task *task = tasks[i];
-        if (task && !strcmp(task->waiting_for, name)) {
+    LIST_FOR_EACH (task, &waiters, struct task, waiter_next) {
+        if (!strcmp(task->waiting_for, name)) {
             struct message m;
             m.type = SERVICE_LOOKUP_REPLY_MSG;
             m.service_lookup_reply.task = service->task;
-            ipc_reply(task->tid, &m);
+            ipc_reply(task->waiting_tid, &m);
 
             //我不会再等了，所以我会清除它。
             strcpy_safe(task->waiting_for, sizeof(task->waiting_for), "");
+            list_remove(&task->waiter_next);
         }
     }
 }
 
 //返回服务名称对应的任务ID。 ERR_WOULD_BLOCK 如果服务尚未注册
-//把它返还。
-task_t service_lookup_or_wait(struct task *task, const char *name) {
+//把它返还。服务注册后回复给 waiter（发出请求的线程）。
+task_t service_lookup_or_wait(struct task *task, task_t waiter,
+                              const char *name) {
     LIST_FOR_EACH (s, &services, struct service, next) {
         if (!strcmp(s->name, name)) {
             return s->task;
@@ -168,18 +314,20 @@ task_t service_lookup_or_wait(struct task *task, const char *name) {
 
     TRACE("%s: waiting for service \"%s\"", task->name, name);
     strcpy_safe(task->waiting_for, sizeof(task->waiting_for), name);
+    task->waiting_tid = waiter;
+    if (!list_is_linked(&task->waiter_next)) {
+        list_push_back(&waiters, &task->waiter_next);
+    }
+
     return ERR_WOULD_BLOCK;
 }
 
 //如果有任务仍在等待服务，则会提醒您。
 void service_dump(void) {
-    for (int i = 0; i < NUM_TASKS_MAX; i++) {
-        struct task *task = tasks[i];
-        if (task && strlen(task->waiting_for) > 0) {
-            WARN(
-                "%s: stil waiting for a service \"%s\""
-                " (hint: add the server to BOOT_SERVERS in Makefile)",
-                task->name, task->waiting_for);
-        }
+    LIST_FOR_EACH (task, &waiters, struct task, waiter_next) {
+        WARN(
+            "%s: stil waiting for a service \"%s\""
+            " (hint: add the server to BOOT_SERVERS in Makefile)",
+            task->name, task->waiting_for);
     }
 }
@@ -14,7 +14,14 @@
 struct service {
     list_elem_t next;
     char name[SERVICE_NAME_LEN];//服务名称
-    task_t task;//任务ID
+    task_t task;//任务ID（代表任务）
+    list_t workers;//工作任务列表
+};
+
+//线程管理结构。线程共享所属任务的地址空间，因此缺页等由任务管理结构处理。
+struct thread {
+    list_elem_t next;//任务的线程列表的元素
+    task_t tid;//线程的任务ID
 };
 
 //任务管理结构
@@ -28,14 +35,24 @@ struct task {
     elf_ehdr_t *ehdr;//ELF 头
     elf_phdr_t *phdrs;//程序头
     uaddr_t valloc_next;//下一个动态分配的虚拟地址
+    list_t threads;//线程列表（不包括主线程）
     char waiting_for[SERVICE_NAME_LEN];//等待服务注册的服务名
-    bool watch_tasks;//是否监控任务完成情况
+    task_t waiting_tid;//等待服务注册的线程的任务ID
+    list_elem_t waiter_next;//等待服务注册的任务列表的元素
+    list_elem_t watcher_next;//监控任务完成情况的任务列表的元素
+    list_elem_t worker_next;//服务的工作任务列表的元素
 };
 
 struct task *task_find(task_t tid);
+struct task *task_lookup(task_t tid);
 task_t task_spawn(struct bootfs_file *file);
 void task_destroy(struct task *task);
 error_t task_destroy_by_tid(task_t tid);
+task_t task_spawn_thread(struct task *task, uaddr_t ip, uaddr_t sp,
+                         uaddr_t arg);
+void task_destroy_thread(struct task *task, task_t tid);
+void task_watch(struct task *task);
 void service_register(struct task *task, const char *name);
-task_t service_lookup_or_wait(struct task *task, const char *name);
+task_t service_lookup_or_wait(struct task *task, task_t waiter,
+                              const char *name);
 void service_dump(void);
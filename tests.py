@@ -17,6 +17,7 @@ HinaOSの自動テスト (pytest)
 """
 import http
 import http.server
+import re
 import threading
 
 def test_hello_world(run_hinaos):
@@ -32,6 +33,11 @@ def test_read_file(run_hinaos):
     r = run_hinaos("cat hello.txt")
     assert "Hello World from HinaFS" in r.log
 
+def test_read_file_repeatedly(run_hinaos):
+    # 受信ウィンドウのページがfsサーバとの間で行き来し続けても読めること
+    r = run_hinaos("cat hello.txt; cat hello.txt; cat hello.txt; cat hello.txt")
+    assert r.log.count("Hello World from HinaFS") >= 4
+
 def test_write_file(run_hinaos):
     r = run_hinaos("write lfg.txt LFG; cat lfg.txt; ls")
     assert '[FILE] "lfg.txt"' in r.log
@@ -45,11 +51,23 @@ def test_mkdir(run_hinaos):
     r = run_hinaos("mkdir new_dir; ls")
     assert '[DIR ] "new_dir"' in r.log
 
+def test_top(run_hinaos):
+    r = run_hinaos("top 1")
+    assert "TID CPU PRI" in r.log
+    assert re.search(r" vm\s*$", r.log, re.MULTILINE)
+    assert re.search(r" shell\s*$", r.log, re.MULTILINE)
+
 def test_hinavm(run_hinaos):
     r = run_hinaos("start hello_hinavm")
     assert "hinavm_server: pc=7: 123" in r.log
     assert "reply value: 42" in r.log
 
+def test_thread(run_hinaos):
+    r = run_hinaos("start hello_thread")
+    assert "value=1" in r.log
+    assert "value=3" in r.log
+    assert "all threads done" in r.log
+
 def test_crack(run_hinaos):
     # crackに成功するまでタイムアウトを伸ばしていく
     for i in range(1, 5):
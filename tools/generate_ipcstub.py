@@ -123,7 +123,8 @@ class IDLParser:
     def visit_fields(self, tree):
         if len(tree.children) == 1 and tree.children[0].data == "any_fields":
             return {
-                "fields": []
+                "fields": [],
+                "any": True,
             }
 
         fields = []
@@ -188,7 +189,14 @@ def generate(args, idl):
         for field in fields:
             type_ = field["type"]
             if type_["name"] == "bytes":
+                # 長さフィールドを先に置き、可変長部分をフィールドの末尾に寄せる。
+                # カーネルは実際の長さの分だけコピーすればよくなる。
+                defs.append(f"size_t {field['name']}_len")
                 defs.append(f"uint8_t {field['name']}[{type_['nr']}]")
+            elif type_["name"] == "ool":
+                # out-of-lineバッファ: 先頭アドレスと長さ。中身はメッセージに含まれず、
+                # カーネルがページごと受信側に移動する。
+                defs.append(f"uaddr_t {field['name']}")
                 defs.append(f"size_t {field['name']}_len")
             elif type_["name"] == "cstr":
                 defs.append(f"char {field['name']}[{type_['nr']}]")
@@ -200,7 +208,39 @@ def generate(args, idl):
                 defs.append(def_)
         return defs
 
+    def msg_layout(struct_name, fields):
+        # メッセージの中身が任意 (any) の場合は、メッセージ全体をコピーする。
+        if fields.get("any"):
+            return "{ .any = true }"
+
+        # out-of-lineバッファ (ool型) のフィールドがあれば、カーネルが見つけられるように
+        # その位置を記録する。1つのメッセージに添付できるのは1つまで。
+        fields = fields["fields"]
+        ool_fields = [f for f in fields if f["type"]["name"] == "ool"]
+        if len(ool_fields) > 1:
+            raise ParseError(f"{struct_name}: only one ool field is allowed")
+
+        ool = ""
+        if ool_fields:
+            name = ool_fields[0]["name"]
+            ool = (
+                f", .ool = true, .ool_offset = offsetof(struct {struct_name}, {name}), "
+                f".ool_len_offset = offsetof(struct {struct_name}, {name}_len)"
+            )
+
+        # 最後のフィールドがbytes型の場合は、実際の長さ分だけが有効なデータになる。
+        if len(fields) > 0 and fields[-1]["type"]["name"] == "bytes":
+            name = fields[-1]["name"]
+            return (
+                f"{{ .fixed_len = offsetof(struct {struct_name}, {name}), "
+                f".len_offset = offsetof(struct {struct_name}, {name}_len), "
+                f".max_var_len = {fields[-1]['type']['nr']}{ool} }}"
+            )
+
+        return f"{{ .fixed_len = sizeof(struct {struct_name}){ool} }}"
+
     renderer = jinja2.Environment()
+    renderer.globals["msg_layout"] = msg_layout
     renderer.filters["newlines_to_whitespaces"] = lambda text: text.replace("\n", " ")
     renderer.filters["field_defs"] = field_defs
     template = renderer.from_string(
@@ -262,6 +302,16 @@ struct {{ msg.name }}_reply_fields {{ "{" }}
     {% endfor %} \\
     {{ "}" }}
 
+#define IPCSTUB_MSG_LAYOUTS \\
+    {{ "{" }} \\
+    {% for m in messages %} \\
+        [{{ m.id }}] = {{ msg_layout(m.name + "_fields", m.args) }}, \\
+        {%- if not m.oneway %}
+        [{{ m.reply_id }}] = {{ msg_layout(m.name + "_reply_fields", m.rets) }}, \\
+        {%- endif %}
+    {% endfor %} \\
+    {{ "}" }}
+
 #define IPCSTUB_STATIC_ASSERTIONS \\
 {%- for msg in messages %}
     _Static_assert( \\